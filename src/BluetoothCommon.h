@@ -12,6 +12,10 @@
 #define FROMRADIO_UUID "2c55e69e-4993-11ed-b878-0242ac120002"
 #define FROMNUM_UUID "ed9da18c-a800-4f66-a670-aa7547e34453"
 
+/// Optional alternative to FROMRADIO: each read returns as many FromRadio protobufs as fit in one ATT read response, each
+/// preceded by its length as a little endian uint16.  A client opts in just by reading this instead of FROMRADIO.
+#define FROMRADIO_BATCH_UUID "49b397e5-24b1-4804-9d5b-5341730cda7b"
+
 // NRF52 wants these constants as byte arrays
 // Generated here https://yupana-engineering.com/online-uuid-to-c-array-converter - but in REVERSE BYTE ORDER
 extern const uint8_t MESH_SERVICE_UUID_16[], TORADIO_UUID_16[16u], FROMRADIO_UUID_16[], FROMNUM_UUID_16[];
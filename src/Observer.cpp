@@ -1,3 +1,10 @@
 #include "configuration.h"
 #include "Observer.h"
 
+
+concurrency::Lock &observerListLock()
+{
+    // Created on first use, Observables are often globals whose constructors run before ours would
+    static concurrency::Lock lock;
+    return lock;
+}
@@ -1,16 +1,39 @@
 #pragma once
 
+#include "concurrency/LockGuard.h"
 #include <Arduino.h>
-#include <list>
+#include <assert.h>
+
+/// The most observables a single Observer can be watching at once (each costs one ObserverLink inside the observer)
+#ifndef OBSERVER_MAX_OBSERVED
+#define OBSERVER_MAX_OBSERVED 4
+#endif
 
 template <class T> class Observable;
+template <class T> class Observer;
+
+/**
+ * Guards every Observable's list of links, and the cursors of the notifyObservers walks over them.  Observers may come and go
+ * from other tasks (e.g. a BLE client disconnecting) while the main loop is notifying.  Never held while calling onNotify.
+ */
+concurrency::Lock &observerListLock();
+
+/**
+ * One subscription of an Observer to an Observable.  Links live inside the Observer (so subscribing never allocates) and are
+ * chained together into an intrusive singly linked list owned by the Observable.
+ */
+template <class T> struct ObserverLink {
+    Observable<T> *observable; // NULL if this link is unused
+    Observer<T> *observer;
+    ObserverLink<T> *next;
+};
 
 /**
  * An observer which can be mixed in as a baseclass.  Implement onNotify as a method in your class.
  */
 template <class T> class Observer
 {
-  std::list<Observable<T> *> observed;
+    ObserverLink<T> links[OBSERVER_MAX_OBSERVED] = {};
 
   public:
     virtual ~Observer();
@@ -55,52 +78,132 @@ template <class Callback, class T> class CallbackObserver : public Observer<T>
  */
 template <class T> class Observable
 {
-    std::list<Observer<T> *> observers;
+    /// Observers in the order they subscribed
+    ObserverLink<T> *head = NULL;
+
+    /// A notifyObservers in progress (there can be several, nested or from other tasks) and the next link it will call
+    struct Walk {
+        ObserverLink<T> *next;
+        Walk *nextWalk;
+    };
+    Walk *walks = NULL;
 
   public:
+    ~Observable()
+    {
+        concurrency::LockGuard g(&observerListLock());
+
+        // Let our observers know they no longer need to unsubscribe from us
+        for (ObserverLink<T> *l = head; l;) {
+            ObserverLink<T> *next = l->next;
+            l->observable = NULL;
+            l->next = NULL;
+            l = next;
+        }
+    }
+
     /**
      * Tell all observers about a change, observers can process arg as they wish
      *
+     * Observers may unobserve (themselves or others, from any task) while we are walking them, anything removed before we
+     * reach it is skipped.  An observer must not be destroyed while another task might be about to notify it.
+     *
      * returns !0 if an observer chose to abort processing by returning this code
      */
     int notifyObservers(T arg)
     {
-        for (typename std::list<Observer<T> *>::const_iterator iterator = observers.begin(); iterator != observers.end();
-             ++iterator) {
-            int result = (*iterator)->onNotify(arg);
-            if (result != 0)
-                return result;
+        Walk w;
+        {
+            concurrency::LockGuard g(&observerListLock());
+            w.next = head;
+            w.nextWalk = walks;
+            walks = &w;
+        }
+
+        int result = 0;
+        while (result == 0) {
+            Observer<T> *o;
+            {
+                // Step past the link before we call it, removeLink keeps w.next valid from then on
+                concurrency::LockGuard g(&observerListLock());
+                if (!w.next)
+                    break;
+                o = w.next->observer;
+                w.next = w.next->next;
+            }
+            result = o->onNotify(arg);
         }
 
-        return 0;
+        concurrency::LockGuard g(&observerListLock());
+        for (Walk **p = &walks; *p; p = &(*p)->nextWalk)
+            if (*p == &w) {
+                *p = w.nextWalk;
+                break;
+            }
+        return result;
     }
 
   private:
     friend class Observer<T>;
 
     // Not called directly, instead call observer.observe
-    void addObserver(Observer<T> *o) { observers.push_back(o); }
+    void addLink(ObserverLink<T> *link)
+    {
+        concurrency::LockGuard g(&observerListLock());
+        link->next = NULL;
 
-    void removeObserver(Observer<T> *o) { observers.remove(o); }
+        ObserverLink<T> **tail = &head;
+        while (*tail)
+            tail = &(*tail)->next;
+        *tail = link;
+    }
+
+    void removeLink(ObserverLink<T> *link)
+    {
+        concurrency::LockGuard g(&observerListLock());
+
+        // Any walk about to call this link moves on to the one after it
+        for (Walk *w = walks; w; w = w->nextWalk)
+            if (w->next == link)
+                w->next = link->next;
+
+        for (ObserverLink<T> **l = &head; *l; l = &(*l)->next)
+            if (*l == link) {
+                *l = link->next;
+                break;
+            }
+        link->next = NULL;
+    }
 };
 
 template <class T> Observer<T>::~Observer()
 {
-    for (typename std::list<Observable<T> *>::const_iterator iterator = observed.begin(); iterator != observed.end();
-        ++iterator) {
-        (*iterator)->removeObserver(this);
-    }
-    observed.clear();
+    for (int i = 0; i < OBSERVER_MAX_OBSERVED; i++)
+        if (links[i].observable) {
+            links[i].observable->removeLink(&links[i]);
+            links[i].observable = NULL;
+        }
 }
 
 template <class T> void Observer<T>::unobserve(Observable<T> *o)
 {
-    o->removeObserver(this);
-    observed.remove(o);
+    for (int i = 0; i < OBSERVER_MAX_OBSERVED; i++)
+        if (links[i].observable == o) {
+            o->removeLink(&links[i]);
+            links[i].observable = NULL;
+            break;
+        }
 }
 
 template <class T> void Observer<T>::observe(Observable<T> *o)
 {
-    observed.push_back(o);
-    o->addObserver(this);
+    for (int i = 0; i < OBSERVER_MAX_OBSERVED; i++)
+        if (!links[i].observable) {
+            links[i].observable = o;
+            links[i].observer = this;
+            o->addLink(&links[i]);
+            return;
+        }
+
+    assert(0); // Raise OBSERVER_MAX_OBSERVED if an observer really needs to watch more sources
 }
@@ -236,6 +236,7 @@ bool Power::setup()
 
 void Power::shutdown()
 {
+    nodeDB.flushSaves();
     screen->setOn(false);
 #if defined(USE_EINK) && defined(PIN_EINK_EN)
     digitalWrite(PIN_EINK_EN, LOW); //power off backlight first
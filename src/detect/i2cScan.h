@@ -1,6 +1,8 @@
 #include "../configuration.h"
 #include "../main.h"
+#include "FSCommon.h"
 #include <Wire.h>
+#include <ErriezCRC32.h>
 #include "mesh/generated/telemetry.pb.h"
 
 // AXP192 and AXP2101 have the same device address, we just need to identify it in Power.cpp
@@ -10,6 +12,93 @@
 
 #if HAS_WIRE
 
+/// How many slow identification probes (register reads) we remember between boots
+#define I2C_CACHE_MAX_PROBES 16
+
+/**
+ * What scanI2Cdevice() found last boot.  If exactly the same addresses answer this time we reuse the results of the
+ * register reads we did to tell devices apart, those (with their settling delays) are most of the time a scan takes.
+ * Each reuse is still checked with one quick read (a chip ID or status byte) so a swapped part gets probed properly.
+ */
+struct I2CScanCache {
+    uint32_t found[4]; // bit n set if a device answered at address n
+    uint8_t numProbes;
+    struct {
+        uint8_t addr;
+        uint16_t value; // what the identification probe returned
+        uint16_t check; // what the verify read returned at the same time
+    } probes[I2C_CACHE_MAX_PROBES];
+    uint32_t crc; // crc32 of everything above
+};
+
+static const char *i2cCacheFileName = "/prefs/i2c.cache";
+static I2CScanCache i2cCache, i2cCacheNext;
+static bool i2cCacheValid;
+
+/// Load the cache, it is only valid if the same set of addresses answered this time
+static void loadI2CCache(const uint32_t found[4])
+{
+    i2cCacheValid = false;
+#ifdef FSCom
+    auto f = FSCom.open(i2cCacheFileName, FILE_O_READ);
+    if (!f)
+        return;
+    bool okay = f.read((uint8_t *)&i2cCache, sizeof(i2cCache)) == sizeof(i2cCache);
+    f.close();
+
+    i2cCacheValid = okay && i2cCache.crc == crc32Buffer(&i2cCache, offsetof(I2CScanCache, crc)) &&
+                    i2cCache.numProbes <= I2C_CACHE_MAX_PROBES && memcmp(i2cCache.found, found, sizeof(i2cCache.found)) == 0;
+    LOG_DEBUG("I2C scan cache %s\n", i2cCacheValid ? "matches, only verifying devices" : "is stale or missing");
+#endif
+}
+
+/// Write the results of this scan, if they differ from what we already have
+static void saveI2CCache()
+{
+#ifdef FSCom
+    i2cCacheNext.crc = crc32Buffer(&i2cCacheNext, offsetof(I2CScanCache, crc));
+    if (i2cCacheValid && memcmp(&i2cCache, &i2cCacheNext, sizeof(i2cCache)) == 0)
+        return;
+
+    FSCom.mkdir("/prefs");
+    auto f = FSCom.open(i2cCacheFileName, FILE_O_WRITE);
+    if (!f || f.write((uint8_t *)&i2cCacheNext, sizeof(i2cCacheNext)) != sizeof(i2cCacheNext))
+        LOG_WARN("Can't write %s\n", i2cCacheFileName);
+    if (f)
+        f.close();
+#endif
+}
+
+/**
+ * Identify the device at addr with probe(), or reuse what it told us last boot if verify() (a single cheap read) still
+ * returns what it did then
+ */
+template <typename F, typename V> static uint16_t cachedProbe(uint8_t addr, F probe, V verify)
+{
+    uint16_t value = 0, check = verify();
+    bool cached = false;
+    for (uint8_t i = 0; i2cCacheValid && i < i2cCache.numProbes && !cached; i++)
+        if (i2cCache.probes[i].addr == addr) {
+            if (i2cCache.probes[i].check == check) {
+                value = i2cCache.probes[i].value;
+                cached = true;
+            } else {
+                LOG_DEBUG("I2C device at 0x%x changed, probing it again\n", addr);
+                break;
+            }
+        }
+    if (!cached)
+        value = probe();
+
+    if (i2cCacheNext.numProbes < I2C_CACHE_MAX_PROBES) {
+        i2cCacheNext.probes[i2cCacheNext.numProbes].addr = addr;
+        i2cCacheNext.probes[i2cCacheNext.numProbes].value = value;
+        i2cCacheNext.probes[i2cCacheNext.numProbes].check = check;
+        i2cCacheNext.numProbes++;
+    }
+    return value;
+}
+
 void printATECCInfo()
 {
 #if !defined(ARCH_PORTDUINO) && !defined(ARCH_STM32WL)
@@ -62,6 +151,29 @@ uint16_t getRegisterValue(uint8_t address, uint8_t reg, uint8_t length) {
     return value;
 }
 
+/// Read a register without the settling delay getRegisterValue() allows, good enough to confirm a chip ID we already know
+static uint16_t quickRegisterValue(uint8_t address, uint8_t reg, uint8_t length)
+{
+    uint16_t value = 0;
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    Wire.endTransmission();
+    Wire.requestFrom(address, length);
+    while (Wire.available())
+        value = (value << 8) | Wire.read();
+    return value;
+}
+
+/// One read of an OLED controller's status byte, which differs between the SSD1306 and SH1106
+static uint16_t oledStatus(uint8_t addr)
+{
+    Wire.beginTransmission(addr);
+    Wire.write(0x00);
+    Wire.endTransmission();
+    Wire.requestFrom((int)addr, 1);
+    return Wire.available() ? (Wire.read() & 0x0f) : 0xffff;
+}
+
 uint8_t oled_probe(byte addr)
 {
     uint8_t r = 0;
@@ -95,17 +207,30 @@ void scanI2Cdevice()
     byte err, addr;
     uint16_t registerValue = 0x00;
     int nDevices = 0;
+
+    // First just see who answers, that is quick and tells us if the bus changed since the cache was written
+    memset(&i2cCacheNext, 0, sizeof(i2cCacheNext));
     for (addr = 1; addr < 127; addr++) {
         Wire.beginTransmission(addr);
         err = Wire.endTransmission();
         if (err == 0) {
+            i2cCacheNext.found[addr / 32] |= 1UL << (addr % 32);
+        } else if (err == 4) {
+            LOG_ERROR("Unknow error at address 0x%x\n", addr);
+        }
+    }
+    loadI2CCache(i2cCacheNext.found);
+
+    for (addr = 1; addr < 127; addr++) {
+        if (i2cCacheNext.found[addr / 32] & (1UL << (addr % 32))) {
             LOG_DEBUG("I2C device found at address 0x%x\n", addr);
 
             nDevices++;
 
             if (addr == SSD1306_ADDRESS) {
                 screen_found = addr;
-                screen_model = oled_probe(addr);
+                screen_model = cachedProbe(
+                    addr, [&]() { return oled_probe(addr); }, [&]() { return oledStatus(addr); });
                 if (screen_model == 1) {
                     LOG_INFO("ssd1306 display found\n");
                 } else if (screen_model == 2) {
@@ -144,7 +269,8 @@ void scanI2Cdevice()
             if (addr == CARDKB_ADDR) {
                 cardkb_found = addr;
                 // Do we have the RAK14006 instead?
-                registerValue = getRegisterValue(addr, 0x04, 1);
+                registerValue = cachedProbe(
+                    addr, [&]() { return getRegisterValue(addr, 0x04, 1); }, [&]() { return quickRegisterValue(addr, 0x04, 1); });
                 if (registerValue == 0x02) { // KEYPAD_VERSION
                     LOG_INFO("RAK14004 found\n");
                     kb_model = 0x02;
@@ -164,7 +290,9 @@ void scanI2Cdevice()
             }
 #endif
             if (addr == BME_ADDR || addr == BME_ADDR_ALTERNATE) {
-                registerValue = getRegisterValue(addr, 0xD0, 1); // GET_ID
+                registerValue = cachedProbe(
+                    addr, [&]() { return getRegisterValue(addr, 0xD0, 1); }, // GET_ID
+                    [&]() { return quickRegisterValue(addr, 0xD0, 1); });
                 if (registerValue == 0x61) {
                     LOG_INFO("BME-680 sensor found at address 0x%x\n", (uint8_t)addr);
                     nodeTelemetrySensorsMap[TelemetrySensorType_BME680] = addr;
@@ -177,7 +305,8 @@ void scanI2Cdevice()
                 }
             }
             if (addr == INA_ADDR || addr == INA_ADDR_ALTERNATE) {
-                registerValue = getRegisterValue(addr, 0xFE, 2);
+                registerValue = cachedProbe(
+                    addr, [&]() { return getRegisterValue(addr, 0xFE, 2); }, [&]() { return quickRegisterValue(addr, 0xFE, 2); });
                 LOG_DEBUG("Register MFG_UID: 0x%x\n", registerValue);
                 if (registerValue == 0x5449) {
                     LOG_INFO("INA260 sensor found at address 0x%x\n", (uint8_t)addr);
@@ -217,10 +346,9 @@ void scanI2Cdevice()
                 LOG_INFO("QMC5883L Highrate 3-Axis magnetic sensor found\n");
                 nodeTelemetrySensorsMap[TelemetrySensorType_QMC5883L] = addr;
             }
-        } else if (err == 4) {
-            LOG_ERROR("Unknow error at address 0x%x\n", addr);
         }
     }
+    saveI2CCache();
 
     if (nDevices == 0)
         LOG_INFO("No I2C devices found\n");
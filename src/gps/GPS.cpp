@@ -430,7 +430,7 @@ int32_t GPS::runOnce()
             if(devicestate.did_gps_reset && (millis() > 60000) && !hasFlow()) {
                 LOG_DEBUG("GPS is not communicating, trying factory reset on next bootup.\n");
                 devicestate.did_gps_reset = false;
-                nodeDB.saveDeviceStateToDisk();
+                nodeDB.requestSave(SEGMENT_DEVICESTATE);
             }
         }
     }
@@ -208,26 +208,6 @@ static void drawOEMBootScreen(OLEDDisplay *display, OLEDDisplayUiState *state, i
     drawOEMIconScreen(region, display, state, x, y);
 }
 
-// Used on boot when a certificate is being created
-static void drawSSLScreen(OLEDDisplay *display, OLEDDisplayUiState *state, int16_t x, int16_t y)
-{
-    display->setTextAlignment(TEXT_ALIGN_CENTER);
-    display->setFont(FONT_SMALL);
-    display->drawString(64 + x, y, "Creating SSL certificate");
-
-#ifdef ARCH_ESP32
-    yield();
-    esp_task_wdt_reset();
-#endif
-
-    display->setFont(FONT_SMALL);
-    if ((millis() / 1000) % 2) {
-        display->drawString(64 + x, FONT_HEIGHT_SMALL + y + 2, "Please wait . . .");
-    } else {
-        display->drawString(64 + x, FONT_HEIGHT_SMALL + y + 2, "Please wait . .  ");
-    }
-}
-
 // Used when booting without a region set
 static void drawWelcomeScreen(OLEDDisplay *display, OLEDDisplayUiState *state, int16_t x, int16_t y)
 {
@@ -1189,18 +1169,6 @@ void Screen::drawDebugInfoWiFiTrampoline(OLEDDisplay *display, OLEDDisplayUiStat
     screen2->debugInfo.drawFrameWiFi(display, state, x, y);
 }
 
-/* show a message that the SSL cert is being built
- * it is expected that this will be used during the boot phase */
-void Screen::setSSLFrames()
-{
-    if (address_found) {
-        // LOG_DEBUG("showing SSL frames\n");
-        static FrameCallback sslFrames[] = {drawSSLScreen};
-        ui.setFrames(sslFrames, 1);
-        ui.update();
-    }
-}
-
 /* show a message that the SSL cert is being built
  * it is expected that this will be used during the boot phase */
 void Screen::setWelcomeFrames()
@@ -154,6 +154,16 @@ __attribute__((weak, noinline)) bool loopCanSleep()
     return true;
 }
 
+static uint32_t bootPhaseMsec;
+
+/// Log how long the part of setup() which just finished took, so slow boot steps are easy to spot
+static void bootPhaseDone(const char *phase)
+{
+    uint32_t now = millis();
+    LOG_DEBUG("Boot: %s took %u msec\n", phase, now - bootPhaseMsec);
+    bootPhaseMsec = now;
+}
+
 void setup()
 {
     concurrency::hasBeenSetup = true;
@@ -173,6 +183,7 @@ void setup()
 #endif
 
     serialSinceMsec = millis();
+    bootPhaseMsec = serialSinceMsec;
 
     LOG_INFO("\n\n//\\ E S H T /\\ S T / C\n\n");
 
@@ -214,6 +225,7 @@ void setup()
     ledPeriodic = new Periodic("Blink", ledBlinker);
 
     fsInit();
+    bootPhaseDone("filesystem");
 
     router = new ReliableRouter();
 
@@ -248,6 +260,7 @@ void setup()
     power->setStatusHandler(powerStatus);
     powerStatus->observe(&power->newStatus);
     power->setup(); // Must be after status handler is installed, so that handler gets notified of the initial configuration
+    bootPhaseDone("power");
 
 
 #ifdef LILYGO_TBEAM_S3_CORE
@@ -262,6 +275,7 @@ void setup()
 
     // We need to scan here to decide if we have a screen for nodeDB.init()
     scanI2Cdevice();
+    bootPhaseDone("I2C scan");
 
 #ifdef HAS_SDCARD
     setupSDCard();
@@ -298,6 +312,7 @@ void setup()
     // We do this as early as possible because this loads preferences from flash
     // but we need to do this after main cpu iniot (esp32setup), because we need the random seed set
     nodeDB.init();
+    bootPhaseDone("NodeDB");
 
     playStartMelody();
 
@@ -326,6 +341,7 @@ void setup()
         gpsStatus->observe(&gps->newStatus);
     else
         LOG_WARN("No GPS found - running without GPS\n");
+    bootPhaseDone("screen and GPS");
 
     nodeStatus->observe(&nodeDB.newStatus);
 
@@ -333,6 +349,7 @@ void setup()
 
     // Now that the mesh service is created, create any modules
     setupModules();
+    bootPhaseDone("service and modules");
 
     // Do this after service.init (because that clears error_code)
 #ifdef HAS_PMU
@@ -350,6 +367,7 @@ void setup()
 #endif
 
     screen->print("Started...\n");
+    bootPhaseDone("screen setup");
 
     // We have now loaded our saved preferences from flash
 
@@ -358,7 +376,7 @@ void setup()
         LOG_WARN("GPS FactoryReset requested\n");
         if (gps->factoryReset()) { // If we don't succeed try again next time
             devicestate.did_gps_reset = true;
-            nodeDB.saveToDisk(SEGMENT_DEVICESTATE);
+            nodeDB.requestSave(SEGMENT_DEVICESTATE);
         }
     }
 
@@ -447,13 +465,14 @@ void setup()
         }
     }
 #endif
+    bootPhaseDone("radio");
 
 // check if the radio chip matches the selected region
 
 if((config.lora.region == Config_LoRaConfig_RegionCode_LORA_24) && (!rIf->wideLora())){
     LOG_WARN("Radio chip does not support 2.4GHz LoRa. Reverting to unset.\n");
     config.lora.region = Config_LoRaConfig_RegionCode_UNSET;
-    nodeDB.saveToDisk(SEGMENT_CONFIG);
+    nodeDB.requestSave(SEGMENT_CONFIG);
     if(!rIf->reconfigure()) {
         LOG_WARN("Reconfigure failed, rebooting\n");
         screen->startRebootScreen();
@@ -481,6 +500,7 @@ if((config.lora.region == Config_LoRaConfig_RegionCode_LORA_24) && (!rIf->wideLo
 #ifdef ARCH_PORTDUINO
     initApiServer(TCPPort);
 #endif
+    bootPhaseDone("network");
 
     // Start airtime logger thread.
     airTime = new AirTime();
@@ -502,6 +522,8 @@ if((config.lora.region == Config_LoRaConfig_RegionCode_LORA_24) && (!rIf->wideLo
 
     // setBluetoothEnable(false); we now don't start bluetooth until we enter the proper state
     setCPUFast(false); // 80MHz is fine for our slow peripherals
+
+    LOG_INFO("Boot: setup took %u msec (%u msec since power on)\n", millis() - serialSinceMsec, millis());
 }
 
 uint32_t rebootAtMsec;   // If not zero we will reboot at this time (used to reboot shortly after the update completes)
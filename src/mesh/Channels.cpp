@@ -1,6 +1,8 @@
 #include "Channels.h"
 #include "CryptoEngine.h"
+#include "MeshModule.h"
 #include "NodeDB.h"
+#include "PhoneAPI.h"
 #include "configuration.h"
 
 #include <assert.h>
@@ -187,6 +189,9 @@ void Channels::onConfigChanged()
         if (ch.role == Channel_Role_PRIMARY)
             primaryIndex = i;
     }
+
+    MeshModule::invalidateDispatchTable(); // Channel names might have changed, so boundChannel indexes need resolving again
+    PhoneAPI::invalidateConfigCache();
 }
 
 Channel &Channels::getByIndex(ChannelIndex chIndex)
@@ -229,6 +234,7 @@ void Channels::setChannel(const Channel &c)
                 channelFile.channels[i].role = Channel_Role_SECONDARY;
 
     old = c; // slam in the new settings/role
+    PhoneAPI::invalidateConfigCache();
 }
 
 const char *Channels::getName(size_t chIndex)
@@ -27,6 +27,13 @@ bool FloodingRouter::shouldFilterReceived(const MeshPacket *p)
     return Router::shouldFilterReceived(p);
 }
 
+bool FloodingRouter::shouldRebroadcast(const MeshPacket *p)
+{
+    // The same rules sniffReceived applies below
+    return (p->to != getNodeNum()) && (p->hop_limit > 0) && (getFrom(p) != getNodeNum()) && (p->id != 0) &&
+           (config.device.role != Config_DeviceConfig_Role_CLIENT_MUTE);
+}
+
 void FloodingRouter::sniffReceived(const MeshPacket *p, const Routing *c)
 {
     bool isAck = ((c && c->error_reason == Routing_Error_NONE)); // consider only ROUTING_APP message without error as ACK
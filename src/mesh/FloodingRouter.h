@@ -53,6 +53,10 @@ class FloodingRouter : public Router, protected PacketHistory
      */
     virtual bool shouldFilterReceived(const MeshPacket *p) override;
 
+    virtual bool isDuplicate(const MeshPacket *p) override { return wasSeenRecently(p, false); }
+
+    virtual bool shouldRebroadcast(const MeshPacket *p) override;
+
     /**
      * Look for broadcasts we need to rebroadcast
      */
@@ -8,6 +8,12 @@
 
 std::vector<MeshModule *> *MeshModule::modules;
 
+std::unordered_map<uint32_t, std::vector<MeshModule *>> *MeshModule::portDispatch;
+std::vector<MeshModule *> *MeshModule::anyPortModules;
+std::vector<MeshModule *> *MeshModule::encryptedModules;
+bool MeshModule::dispatchDirty = true;
+uint8_t MeshModule::dispatchDepth;
+
 const MeshPacket *MeshModule::currentRequest;
 
 /**
@@ -23,6 +29,7 @@ MeshModule::MeshModule(const char *_name) : name(_name)
         modules = new std::vector<MeshModule *>();
 
     modules->push_back(this);
+    dispatchDirty = true;
 }
 
 void MeshModule::setup() {}
@@ -66,6 +73,58 @@ MeshPacket *MeshModule::allocErrorResponse(Routing_Error err, const MeshPacket *
     return r;
 }
 
+void MeshModule::rebuildDispatchTable()
+{
+    if (!portDispatch) {
+        portDispatch = new std::unordered_map<uint32_t, std::vector<MeshModule *>>();
+        anyPortModules = new std::vector<MeshModule *>();
+        encryptedModules = new std::vector<MeshModule *>();
+    }
+    portDispatch->clear();
+    anyPortModules->clear();
+    encryptedModules->clear();
+    dispatchDirty = false;
+
+    if (!modules)
+        return;
+
+    for (auto i = modules->begin(); i != modules->end(); ++i) {
+        auto &pi = **i;
+
+        if (pi.encryptedOk)
+            encryptedModules->push_back(&pi);
+
+        pi.boundChannelMask = 0;
+        if (pi.boundChannel)
+            for (ChannelIndex ch = 0; ch < channels.getNumChannels(); ch++)
+                if (strcasecmp(channels.getByIndex(ch).settings.name, pi.boundChannel) == 0)
+                    pi.boundChannelMask |= (1 << ch);
+
+        bool wantsAll = true;
+        for (uint32_t port = 0; port <= _PortNum_MAX && wantsAll; port++)
+            wantsAll = pi.wantPortNum((PortNum)port);
+
+        if (wantsAll) {
+            anyPortModules->push_back(&pi);
+            // Keep registration order in the per port lists (RoutingModule relies on being last)
+            for (auto p = portDispatch->begin(); p != portDispatch->end(); ++p)
+                p->second.push_back(&pi);
+        } else {
+            for (uint32_t port = 0; port <= _PortNum_MAX; port++) {
+                if (pi.wantPortNum((PortNum)port)) {
+                    auto found = portDispatch->find(port);
+                    if (found == portDispatch->end())
+                        found = portDispatch->emplace(port, *anyPortModules).first; // Start with the catch-all modules so far
+                    found->second.push_back(&pi);
+                }
+            }
+        }
+    }
+
+    LOG_DEBUG("Module dispatch table built, %d portnums, %d modules want every port\n", portDispatch->size(),
+              anyPortModules->size());
+}
+
 void MeshModule::callPlugins(const MeshPacket &mp, RxSource src)
 {
     // LOG_DEBUG("In call modules\n");
@@ -80,7 +139,18 @@ void MeshModule::callPlugins(const MeshPacket &mp, RxSource src)
     auto ourNodeNum = nodeDB.getNodeNum();
     bool toUs = mp.to == NODENUM_BROADCAST || mp.to == ourNodeNum;
 
-    for (auto i = modules->begin(); i != modules->end(); ++i) {
+    // Don't rebuild underneath an outer callPlugins that is still walking one of our lists
+    if (dispatchDirty && !dispatchDepth)
+        rebuildDispatchTable();
+
+    const std::vector<MeshModule *> *candidates = encryptedModules;
+    if (isDecoded) {
+        auto found = portDispatch->find(mp.decoded.portnum);
+        candidates = (found != portDispatch->end()) ? &found->second : anyPortModules;
+    }
+
+    dispatchDepth++;
+    for (auto i = candidates->begin(); i != candidates->end(); ++i) {
         auto &pi = **i;
 
         pi.currentRequest = &mp;
@@ -100,16 +170,15 @@ void MeshModule::callPlugins(const MeshPacket &mp, RxSource src)
 
             moduleFound = true;
 
-            /// received channel (or NULL if not decoded)
-            Channel *ch = isDecoded ? &channels.getByIndex(mp.channel) : NULL;
-
             /// Is the channel this packet arrived on acceptable? (security check)
             /// Note: we can't know channel names for encrypted packets, so those are NEVER sent to boundChannel modules
 
             /// Also: if a packet comes in on the local PC interface, we don't check for bound channels, because it is TRUSTED and it needs to
             /// to be able to fetch the initial admin packets without yet knowing any channels.
 
-            bool rxChannelOk = !pi.boundChannel || (mp.from == 0) || (strcasecmp(ch->settings.name, pi.boundChannel) == 0);
+            bool rxChannelOk = !pi.boundChannel || (mp.from == 0) ||
+                               (isDecoded && mp.channel < 8 * sizeof(pi.boundChannelMask) &&
+                                (pi.boundChannelMask & (1 << mp.channel)));
 
             if (!rxChannelOk) {
                 // no one should have already replied!
@@ -155,6 +224,7 @@ void MeshModule::callPlugins(const MeshPacket &mp, RxSource src)
 
         pi.currentRequest = NULL;
     }
+    dispatchDepth--;
 
     if (mp.decoded.want_response && toUs) {
         if (currentReply) {
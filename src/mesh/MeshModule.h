@@ -2,6 +2,7 @@
 
 #include "mesh/Channels.h"
 #include "mesh/MeshTypes.h"
+#include <unordered_map>
 #include <vector>
 
 #if HAS_SCREEN
@@ -56,6 +57,21 @@ class MeshModule
 {
     static std::vector<MeshModule *> *modules;
 
+    /// For each portnum some module specifically asked for, the modules which might want it (in registration order)
+    static std::unordered_map<uint32_t, std::vector<MeshModule *>> *portDispatch;
+
+    /// Modules which want every portnum, used as is for any portnum not in portDispatch
+    static std::vector<MeshModule *> *anyPortModules;
+
+    /// Modules with encryptedOk set, the only ones considered for packets we couldn't decode
+    static std::vector<MeshModule *> *encryptedModules;
+
+    /// Set when modules or channels change, the dispatch tables get rebuilt before the next packet is dispatched
+    static bool dispatchDirty;
+
+    /// How many callPlugins invocations are on the stack (modules can send packets which are delivered locally)
+    static uint8_t dispatchDepth;
+
   public:
     /** Constructor
      * name is for debugging output
@@ -68,6 +84,11 @@ class MeshModule
      */
     static void callPlugins(const MeshPacket &mp, RxSource src = RX_SRC_RADIO);
 
+    /** Call this if a module changed which portnums it wants or channels were renamed, the dispatch tables
+     * will be rebuilt before the next packet is handled
+     */
+    static void invalidateDispatchTable() { dispatchDirty = true; }
+
     static std::vector<MeshModule *> GetMeshModulesWithUIFrames();
     static void observeUIEvents(Observer<const UIFrameEvent *> *observer);
     static AdminMessageHandleResult handleAdminMessageForAllPlugins(
@@ -125,6 +146,16 @@ class MeshModule
      */
     virtual bool wantPacket(const MeshPacket *p) = 0;
 
+    /**
+     * Used to build the portnum dispatch table, wantPacket() is only called for packets on portnums where this returned true.
+     * So this must be a superset of wantPacket(): any portnum on which wantPacket() could accept a decoded packet (even one
+     * it picks on other fields too) needs true here, or the module silently never sees those packets.
+     * If your module's choice of portnum changes at runtime, call invalidateDispatchTable().
+     *
+     * @return true if you might want to receive packets with the specified portnum (the default is to see everything)
+     */
+    virtual bool wantPortNum(PortNum portnum) { return true; }
+
     /** Called to handle a particular incoming message
 
     @return ProcessMessage::STOP if you've guaranteed you've handled this message and no other handlers should be considered for it
@@ -170,8 +201,14 @@ class MeshModule
      */
     static MeshPacket *currentReply;
 
+    /// The channel indexes whose name matches boundChannel, resolved when the dispatch tables are built
+    uint8_t boundChannelMask = 0;
+
     friend class ReliableRouter;
 
+    /// Rebuild portDispatch, anyPortModules, encryptedModules and every boundChannelMask
+    static void rebuildDispatchTable();
+
     /** Messages can be received that have the want_response bit set.  If set, this callback will be invoked
      * so that subclasses can (optionally) send a response back to the original sender.  This method calls allocReply()
      * to generate the reply message, and if !NULL that message will be delivered to whoever sent req
@@ -7,6 +7,8 @@
 #include "BluetoothCommon.h" // needed for updateBatteryLevel, FIXME, eventually when we pull mesh out into a lib we shouldn't be whacking bluetooth from here
 #include "MeshService.h"
 #include "NodeDB.h"
+#include "PacketTrace.h"
+#include "PhoneAPI.h"
 #include "PowerFSM.h"
 #include "RTC.h"
 #include "main.h"
@@ -57,7 +59,7 @@ Allocator<QueueStatus> &queueStatusPool = staticQueueStatusPool;
 
 #include "Router.h"
 
-MeshService::MeshService() : toPhoneQueue(MAX_RX_TOPHONE), toPhoneQueueStatusQueue(MAX_RX_TOPHONE)
+MeshService::MeshService() : toPhoneQueueStatusQueue(MAX_RX_TOPHONE)
 {
     lastQueueStatus = { 0, 0, 16, 0 };
 }
@@ -69,6 +71,11 @@ void MeshService::init()
 
     if (gps)
         gpsObserver.observe(&gps->newStatus);
+
+    // Packets the phone hadn't collected when we last rebooted or went to deep sleep
+    toPhoneQueue.load();
+    if (!toPhoneQueue.isEmpty())
+        fromNum++;
 }
 
 int MeshService::handleFromRadio(const MeshPacket *mp)
@@ -95,6 +102,8 @@ void MeshService::loop()
         fromNumChanged.notifyObservers(fromNum);
         oldFromNum = fromNum;
     }
+
+    toPhoneQueue.flush();
 }
 
 /// The radioConfig object just changed, call this to force the hw to change to the new settings
@@ -104,9 +113,10 @@ bool MeshService::reloadConfig(int saveWhat)
 
     // This will also update the region as needed
     bool didReset = nodeDB.resetRadioConfig(); // Don't let the phone send us fatally bad settings
+    PhoneAPI::invalidateConfigCache();
 
     configChanged.notifyObservers(NULL); // This will cause radio hardware to change freqs etc
-    nodeDB.saveToDisk(saveWhat);
+    nodeDB.requestSave(saveWhat);
 
     return didReset;
 }
@@ -121,7 +131,7 @@ void MeshService::reloadOwner(bool shouldSave)
     // update everyone else and save to disk
     if (nodeInfoModule && shouldSave) {
         nodeInfoModule->sendOurNodeInfo();
-        nodeDB.saveToDisk(SEGMENT_DEVICESTATE);
+        nodeDB.requestSave(SEGMENT_DEVICESTATE);
     }
 }
 
@@ -250,16 +260,11 @@ void MeshService::sendNetworkPing(NodeNum dest, bool wantReplies)
 
 void MeshService::sendToPhone(MeshPacket *p)
 {
-    if (toPhoneQueue.numFree() == 0) {
-        LOG_WARN("ToPhone queue is full, discarding oldest\n");
-        MeshPacket *d = toPhoneQueue.dequeuePtr(0);
-        if (d)
-            releaseToPool(d);
-    }
-
     MeshPacket *copied = packetPool.allocCopy(*p);
     perhapsDecode(copied);
-    assert(toPhoneQueue.enqueue(copied, 0));
+    packetForPhone.notifyObservers(copied); // Before the shared queue has it, a BLE phone could collect and free it any time
+    PACKET_TRACE(copied->id, TRACE_TO_PHONE); // Also before the enqueue, copied may be gone as soon as that returns
+    toPhoneQueue.enqueue(copied); // Discards the oldest if the phone hasn't been keeping up
     fromNum++;
 }
 
@@ -10,6 +10,7 @@
 #include "MeshTypes.h"
 #include "Observer.h"
 #include "PointerQueue.h"
+#include "ToPhoneQueue.h"
 #ifdef ARCH_PORTDUINO
 #include "../platform/portduino/SimRadio.h"
 #endif
@@ -25,11 +26,8 @@ class MeshService
     CallbackObserver<MeshService, const meshtastic::GPSStatus *> gpsObserver =
         CallbackObserver<MeshService, const meshtastic::GPSStatus *>(this, &MeshService::onGPSChanged);
 
-    /// received packets waiting for the phone to process them
-    /// FIXME, change to a DropOldestQueue and keep a count of the number of dropped packets to ensure
-    /// we never hang because android hasn't been there in a while
-    /// FIXME - save this to flash on deep sleep
-    PointerQueue<MeshPacket> toPhoneQueue;
+    /// received packets waiting for the phone to process them (bounded, and kept in flash if the phone is away for a while)
+    ToPhoneQueue toPhoneQueue;
 
     // keep list of QueueStatus packets to be send to the phone
     PointerQueue<QueueStatus> toPhoneQueueStatusQueue;
@@ -47,6 +45,10 @@ class MeshService
     /// Called when some new packets have arrived from one of the radios
     Observable<uint32_t> fromNumChanged;
 
+    /// Called with each packet as it is queued for the phone, for API clients which keep queues of their own (they must copy
+    /// it, the packet belongs to the shared queue)
+    Observable<const MeshPacket *> packetForPhone;
+
     /// Called when radio config has changed (radios should observe this and set their hardware as required)
     Observable<void *> configChanged;
 
@@ -59,7 +61,13 @@ class MeshService
 
     /// Return the next packet destined to the phone.  FIXME, somehow use fromNum to allow the phone to retry the
     /// last few packets if needs to.
-    MeshPacket *getForPhone() { return toPhoneQueue.dequeuePtr(0); }
+    MeshPacket *getForPhone() { return toPhoneQueue.dequeue(); }
+
+    /// How many packets for the phone we had to discard since boot, because it didn't collect them in time
+    uint32_t getNumDroppedForPhone() { return toPhoneQueue.getNumDropped(); }
+
+    /// Write any packets the phone hasn't collected yet to flash now, call before we reboot or deep sleep
+    void saveToPhoneQueue() { toPhoneQueue.flush(true); }
 
     /// Allows the bluetooth handler to free packets after they have been sent
     void releaseToPool(MeshPacket *p) { packetPool.release(p); }
@@ -77,7 +85,8 @@ class MeshService
      */
     void handleToRadio(MeshPacket &p);
 
-    /** The radioConfig object just changed, call this to force the hw to change to the new settings
+    /** The radioConfig object just changed, call this to force the hw to change to the new settings (and schedule saveWhat to be
+     * written to flash)
      * @return true if client devices should be sent a new set of radio configs
      */
     bool reloadConfig(int saveWhat=SEGMENT_CONFIG | SEGMENT_MODULECONFIG | SEGMENT_DEVICESTATE | SEGMENT_CHANNELS);
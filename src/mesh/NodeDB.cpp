@@ -6,10 +6,12 @@
 #include "GPS.h"
 #include "MeshRadio.h"
 #include "NodeDB.h"
+#include "PBFileStream.h"
 #include "PacketHistory.h"
 #include "PowerFSM.h"
 #include "RTC.h"
 #include "Router.h"
+#include "concurrency/OSThread.h"
 #include "error.h"
 #include "main.h"
 #include "mesh-pb-constants.h"
@@ -57,6 +59,19 @@ User &owner = devicestate.owner;
 
 static uint8_t ourMacAddr[6];
 
+/**
+ * Writes the segments NodeDB::requestSave() asked for.  This runs on the main loop like everything else which touches
+ * our config structs, so we never encode one while it is half way through being edited.
+ */
+class NodeDBSaveThread : public concurrency::OSThread
+{
+  public:
+    NodeDBSaveThread() : OSThread("NodeDBSave") {}
+
+  protected:
+    virtual int32_t runOnce() override { return nodeDB.runSaves(); }
+};
+
 /**
  * The node number the user is currently looking at
  * 0 if none
@@ -238,6 +253,7 @@ void NodeDB::resetNodes()
 {
     devicestate.node_db_count = 0;
     memset(devicestate.node_db, 0, sizeof(devicestate.node_db));
+    restartChangeSeq();
     saveDeviceStateToDisk();
 }
 
@@ -247,7 +263,8 @@ void NodeDB::installDefaultDeviceState()
     memset(&devicestate, 0, sizeof(DeviceState));
 
     *numNodes = 0;
-    
+    restartChangeSeq();
+
     // init our devicestate with valid flags so protobuf writing/reading will work
     devicestate.has_my_node = true;
     devicestate.has_owner = true;
@@ -277,6 +294,10 @@ void NodeDB::init()
     LOG_INFO("Initializing NodeDB\n");
     loadFromDisk();
 
+    // Number this boot's changes from a random start, everything we loaded counts as changed at boot
+    bootSeq = random(NODEDB_SEQ_MASK + 1);
+    restartChangeSeq();
+
     uint32_t devicestateCRC = crc32Buffer(&devicestate, sizeof(devicestate));
     uint32_t configCRC = crc32Buffer(&config, sizeof(config));
     uint32_t channelFileCRC = crc32Buffer(&channelFile, sizeof(channelFile));
@@ -329,6 +350,11 @@ void NodeDB::init()
         saveWhat |= SEGMENT_CHANNELS;
 
     saveToDisk(saveWhat);
+
+    // Whatever is in flash now is our starting point for deciding when the node list needs writing again
+    savedChangeSeq = getChangeSeq();
+    lastNodesSaveMsec = millis();
+    saveThread = new NodeDBSaveThread();
 }
 
 // We reserve a few nodenums for future use
@@ -362,8 +388,12 @@ static const char *prefFileName = "/prefs/db.proto";
 static const char *configFileName = "/prefs/config.proto";
 static const char *moduleConfigFileName = "/prefs/module.proto";
 static const char *channelFileName = "/prefs/channels.proto";
+static const char *nodeJournalFileName = "/prefs/nodes.journal";
 static const char *oemConfigFile = "/oem/oem.proto";
 
+/// One whole node journal record (header plus encoded NodeInfo)
+static uint8_t journalBuf[sizeof(NodeDBJournalRecord) + NodeInfo_size];
+
 
 /** Load a protobuf from a file, return true for success */
 bool NodeDB::loadProto(const char *filename, size_t protoSize, size_t objSize, const pb_msgdesc_t *fields, void *dest_struct)
@@ -376,13 +406,13 @@ bool NodeDB::loadProto(const char *filename, size_t protoSize, size_t objSize, c
 
     if (f) {
         LOG_INFO("Loading %s\n", filename);
-        pb_istream_t stream = {&readcb, &f, protoSize};
+        PBFileIStream in(f, protoSize);
 
         // LOG_DEBUG("Preload channel name=%s\n", channelSettings.name);
 
         memset(dest_struct, 0, objSize);
-        if (!pb_decode(&stream, fields, dest_struct)) {
-            LOG_ERROR("Error: can't decode protobuf %s\n", PB_GET_ERROR(&stream));
+        if (!pb_decode(&in.stream, fields, dest_struct)) {
+            LOG_ERROR("Error: can't decode protobuf %s\n", PB_GET_ERROR(&in.stream));
         } else {
             okay = true;
         }
@@ -408,6 +438,7 @@ void NodeDB::loadFromDisk()
             factoryReset();
         } else {
             LOG_INFO("Loaded saved devicestate version %d\n", devicestate.version);
+            replayJournal();
         }
     }
 
@@ -459,20 +490,24 @@ bool NodeDB::saveProto(const char *filename, size_t protoSize, const pb_msgdesc_
     auto f = FSCom.open(filenameTmp.c_str(), FILE_O_WRITE);
     if (f) {
         LOG_INFO("Saving %s\n", filename);
-        pb_ostream_t stream = {&writecb, &f, protoSize};
+        PBFileOStream out(f, protoSize);
 
-        if (!pb_encode(&stream, fields, dest_struct)) {
-            LOG_ERROR("Error: can't encode protobuf %s\n", PB_GET_ERROR(&stream));
+        if (!pb_encode(&out.stream, fields, dest_struct)) {
+            LOG_ERROR("Error: can't encode protobuf %s\n", PB_GET_ERROR(&out.stream));
+        } else if (!out.flush()) {
+            LOG_ERROR("Error: can't write %s\n", filenameTmp.c_str());
         } else {
             okay = true;
         }
         f.close();
 
-        // brief window of risk here ;-)
-        if (FSCom.exists(filename) && !FSCom.remove(filename))
-            LOG_WARN("Can't remove old pref file\n");
-        if (!renameFile(filenameTmp.c_str(), filename))
-            LOG_ERROR("Error: can't rename new pref file\n");
+        // brief window of risk here ;-) (but never replace a good file with one we failed to write)
+        if (okay) {
+            if (FSCom.exists(filename) && !FSCom.remove(filename))
+                LOG_WARN("Can't remove old pref file\n");
+            if (!renameFile(filenameTmp.c_str(), filename))
+                LOG_ERROR("Error: can't rename new pref file\n");
+        }
     } else {
         LOG_ERROR("Can't write prefs\n");
 #ifdef ARCH_NRF52
@@ -499,6 +534,7 @@ void NodeDB::saveChannelsToDisk()
 #endif
         saveProto(channelFileName, ChannelFile_size, &ChannelFile_msg, &channelFile);
     }
+    dirtySegments &= ~SEGMENT_CHANNELS;
 }
 
 void NodeDB::saveDeviceStateToDisk() 
@@ -507,8 +543,20 @@ void NodeDB::saveDeviceStateToDisk()
 #ifdef FSCom
         FSCom.mkdir("/prefs");
 #endif
-        saveProto(prefFileName, DeviceState_size, &DeviceState_msg, &devicestate);
+        // Every node is in db.proto now, so the journal can go.  If we die before removing it replaying it again does
+        // no harm (replayNode() never lets an old record overwrite newer information), beyond bringing back nodes which
+        // resetNodes() had just dropped
+        if (saveProto(prefFileName, DeviceState_size, &DeviceState_msg, &devicestate)) {
+#ifdef FSCom
+            if (FSCom.exists(nodeJournalFileName) && !FSCom.remove(nodeJournalFileName))
+                LOG_WARN("Can't remove %s\n", nodeJournalFileName);
+#endif
+            journalSize = 0;
+        }
     }
+    dirtySegments &= ~SEGMENT_DEVICESTATE;
+    savedChangeSeq = getChangeSeq();
+    lastNodesSaveMsec = millis();
 }
 
 void NodeDB::saveToDisk(int saveWhat)
@@ -549,14 +597,210 @@ void NodeDB::saveToDisk(int saveWhat)
     } else {
         LOG_DEBUG("***** DEVELOPMENT MODE - DO NOT RELEASE - not saving to flash *****\n");
     }
+    dirtySegments &= ~saveWhat;
 }
 
-const NodeInfo *NodeDB::readNextInfo()
+void NodeDB::requestSave(int saveWhat)
 {
-    if (readPointer < *numNodes)
-        return &nodes[readPointer++];
-    else
-        return NULL;
+    uint32_t now = millis();
+    if (!dirtySegments)
+        firstDirtyMsec = now;
+    dirtySegments |= saveWhat;
+
+    // Each request pushes the write back a little, but never past NODEDB_SAVE_MAX_DELAY_MSEC after the first one
+    uint32_t waited = now - firstDirtyMsec;
+    uint32_t delay = NODEDB_SAVE_DEBOUNCE_MSEC;
+    if (waited + delay > NODEDB_SAVE_MAX_DELAY_MSEC)
+        delay = (waited < NODEDB_SAVE_MAX_DELAY_MSEC) ? NODEDB_SAVE_MAX_DELAY_MSEC - waited : 0;
+    saveAtMsec = now + delay;
+
+    if (saveThread)
+        saveThread->setIntervalFromNow(delay);
+}
+
+void NodeDB::flushSaves()
+{
+    if (dirtySegments) {
+        LOG_INFO("Flushing pending saves (0x%x)\n", dirtySegments);
+        saveToDisk(dirtySegments);
+    }
+
+    if (savedChangeSeq != getChangeSeq())
+        saveNodes();
+}
+
+int32_t NodeDB::runSaves()
+{
+    uint32_t now = millis();
+
+    // The node list changes all the time, so on its own it only gets saved every NODEDB_NODES_SAVE_MSEC
+    if (!(dirtySegments & SEGMENT_DEVICESTATE) && savedChangeSeq != getChangeSeq() &&
+        now - lastNodesSaveMsec >= NODEDB_NODES_SAVE_MSEC) {
+        saveNodes();
+        return dirtySegments ? 0 : 60 * 1000;
+    }
+
+    if (!dirtySegments)
+        return 60 * 1000; // Nothing to do, requestSave() will wake us early if that changes
+
+    if ((int32_t)(saveAtMsec - now) > 0)
+        return saveAtMsec - now;
+
+    // Just the lowest dirty segment this time, so the radio and everything else get a turn between flash writes
+    int segment = dirtySegments & -dirtySegments;
+    LOG_DEBUG("Writing coalesced save (0x%x)\n", segment);
+    saveToDisk(segment);
+
+    return dirtySegments ? 0 : 60 * 1000;
+}
+
+void NodeDB::saveNodes()
+{
+    // Fold the journal back into db.proto once it gets big, or if we can't tell which nodes changed anymore
+    if (devicestate.no_save || journalSize > NODEDB_JOURNAL_MAX_SIZE || !isValidChangeSeq(savedChangeSeq) || !journalNodes())
+        saveDeviceStateToDisk();
+}
+
+bool NodeDB::journalNodes()
+{
+#ifdef FSCom
+    FSCom.mkdir("/prefs");
+    auto f = FSCom.open(nodeJournalFileName, FILE_O_APPEND);
+    if (!f) {
+        LOG_ERROR("Can't append to %s\n", nodeJournalFileName);
+        return false;
+    }
+
+    bool okay = true;
+    int numWritten = 0;
+    uint32_t readIndex = 0;
+    const NodeInfo *info;
+    while (okay && (info = readNextInfo(readIndex, savedChangeSeq)) != NULL) {
+        NodeDBJournalRecord *h = (NodeDBJournalRecord *)journalBuf;
+        memset(h, 0, sizeof(*h));
+        h->len = pb_encode_to_bytes(journalBuf + sizeof(*h), NodeInfo_size, &NodeInfo_msg, info);
+
+        size_t n = sizeof(*h) + h->len;
+        h->crc = crc32Buffer(journalBuf, n);
+        okay = f.write(journalBuf, n) == n;
+        numWritten++;
+    }
+    journalSize = f.size();
+    f.close();
+
+    if (!okay) {
+        LOG_ERROR("Can't write %s\n", nodeJournalFileName);
+        return false;
+    }
+
+    LOG_DEBUG("Journaled %d nodes, journal is now %u bytes\n", numWritten, (unsigned)journalSize);
+    savedChangeSeq = getChangeSeq();
+    lastNodesSaveMsec = millis();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void NodeDB::replayJournal()
+{
+#ifdef FSCom
+    auto f = FSCom.open(nodeJournalFileName, FILE_O_READ);
+    if (!f)
+        return;
+
+    static NodeInfo scratch;
+    int numReplayed = 0;
+    size_t goodSize = 0;
+    NodeDBJournalRecord *h = (NodeDBJournalRecord *)journalBuf;
+    while (f.read(journalBuf, sizeof(*h)) == sizeof(*h)) {
+        if (h->len > NodeInfo_size || f.read(journalBuf + sizeof(*h), h->len) != h->len)
+            break;
+
+        uint32_t crc = h->crc;
+        h->crc = 0;
+        if (crc32Buffer(journalBuf, sizeof(*h) + h->len) != crc)
+            break;
+        goodSize += sizeof(*h) + h->len;
+
+        memset(&scratch, 0, sizeof(scratch));
+        if (pb_decode_from_bytes(journalBuf + sizeof(*h), h->len, &NodeInfo_msg, &scratch)) {
+            replayNode(scratch);
+            numReplayed++;
+        }
+    }
+    journalSize = f.size();
+    f.close();
+
+    LOG_INFO("Replayed %d node updates from %s\n", numReplayed, nodeJournalFileName);
+    if (goodSize != journalSize) {
+        // Anything appended after the damage would never be replayed, so make the next save start a fresh journal
+        LOG_WARN("Ignoring the torn end of %s\n", nodeJournalFileName);
+        journalSize = NODEDB_JOURNAL_MAX_SIZE + 1;
+    }
+#endif
+}
+
+void NodeDB::replayNode(const NodeInfo &n)
+{
+    NodeInfo *info = getNode(n.num);
+    if (!info) {
+        if (*numNodes < MAX_NUM_NODES) {
+            info = &nodes[(*numNodes)++];
+        } else {
+            // Full, take the place of the node we heard from longest ago (as getOrCreateNode would have done)
+            info = &nodes[0];
+            for (int i = 1; i < *numNodes; i++)
+                if (nodes[i].last_heard < info->last_heard)
+                    info = &nodes[i];
+            if (info->last_heard > n.last_heard)
+                return;
+        }
+    } else if (info->last_heard > n.last_heard) {
+        return;
+    }
+
+    *info = n;
+}
+
+const NodeInfo *NodeDB::readNextInfo(uint32_t &readIndex, uint32_t sinceSeq)
+{
+    while (readIndex < *numNodes) {
+        uint32_t i = readIndex++;
+        if (sinceSeq == NODEDB_SEQ_ALL || nodes[i].num == getNodeNum())
+            return &nodes[i];
+
+        // Changed after sinceSeq? (all of this is modulo the sequence number size)
+        uint32_t age = (nodeSeq[i] - sinceSeq) & NODEDB_SEQ_MASK;
+        if (age && age <= ((getChangeSeq() - sinceSeq) & NODEDB_SEQ_MASK))
+            return &nodes[i];
+    }
+
+    return NULL;
+}
+
+bool NodeDB::isValidChangeSeq(uint32_t seq) const
+{
+    // Once the counter is half way around we can't tell old from new anymore, so stop offering incremental syncs
+    if (seq > NODEDB_SEQ_MASK || numChanges > (NODEDB_SEQ_MASK >> 1))
+        return false;
+
+    return ((getChangeSeq() - seq) & NODEDB_SEQ_MASK) <= numChanges;
+}
+
+void NodeDB::markChanged(const NodeInfo *info)
+{
+    numChanges++;
+    nodeSeq[info - nodes] = getChangeSeq();
+}
+
+void NodeDB::restartChangeSeq()
+{
+    // Skip past every number we have handed out, so none of them will validate
+    bootSeq = (getChangeSeq() + 1) & NODEDB_SEQ_MASK;
+    numChanges = 0;
+    for (int i = 0; i < *numNodes; i++)
+        nodeSeq[i] = bootSeq;
 }
 
 /// Given a node, return how many seconds in the past (vs now) that we last heard from it
@@ -627,6 +871,7 @@ void NodeDB::updatePosition(uint32_t nodeId, const Position &p, RxSource src)
             info->position.time = tmp_time;
     }
     info->has_position = true;
+    markChanged(info);
     updateGUIforNode = info;
     notifyObservers(true); // Force an update whether or not our node counts have changed
 }
@@ -650,6 +895,7 @@ void NodeDB::updateTelemetry(uint32_t nodeId, const Telemetry &t, RxSource src)
     }
     info->device_metrics = t.variant.device_metrics;
     info->has_device_metrics = true;
+    markChanged(info);
     updateGUIforNode = info;
     notifyObservers(true); // Force an update whether or not our node counts have changed
 }
@@ -673,6 +919,7 @@ void NodeDB::updateUser(uint32_t nodeId, const User &p)
     info->has_user = true;
 
     if (changed) {
+        markChanged(info);
         updateGUIforNode = info;
         powerFSM.trigger(EVENT_NODEDB_UPDATED);
         notifyObservers(true); // Force an update whether or not our node counts have changed
@@ -700,6 +947,8 @@ void NodeDB::updateFrom(const MeshPacket &mp)
 
         if (mp.rx_snr)
             info->snr = mp.rx_snr; // keep the most recent SNR we received for this node.
+
+        markChanged(info);
     }
 }
 
@@ -731,9 +980,11 @@ NodeInfo *NodeDB::getOrCreateNode(NodeNum n)
                     oldestIndex = i;
                 }
             }
-            // Shove the remaining nodes down the chain
+            // Shove the remaining nodes down the chain (clients syncing incrementally just keep the evicted node, which
+            // is harmless)
             for (int i = oldestIndex; i < *numNodes - 1; i++) {
                 nodes[i] = nodes[i + 1];
+                nodeSeq[i] = nodeSeq[i + 1];
             }
             (*numNodes)--;
         }
@@ -743,6 +994,7 @@ NodeInfo *NodeDB::getOrCreateNode(NodeNum n)
         // everything is missing except the nodenum
         memset(info, 0, sizeof(*info));
         info->num = n;
+        markChanged(info);
     }
 
     return info;
@@ -21,6 +21,36 @@ DeviceState versions used to be defined in the .proto file but really only this
 #define DEVICESTATE_CUR_VER 20
 #define DEVICESTATE_MIN_VER DEVICESTATE_CUR_VER
 
+/// NodeDB change sequence numbers wrap at this many bits, small enough for a client to hand one back inside a want_config_id
+#define NODEDB_SEQ_BITS 24
+#define NODEDB_SEQ_MASK ((1UL << NODEDB_SEQ_BITS) - 1)
+/// Passed to readNextInfo to mean "every node", it is outside of the sequence number range
+#define NODEDB_SEQ_ALL UINT32_MAX
+
+/// A requested save is written once no further requests have come in for this long, so a burst of edits costs one write
+#define NODEDB_SAVE_DEBOUNCE_MSEC (5 * 1000)
+/// ...but we never put a requested save off for longer than this
+#define NODEDB_SAVE_MAX_DELAY_MSEC (30 * 1000)
+/// Changes to the node list alone (which happen with almost every packet we hear) are appended to the node journal this often
+#define NODEDB_NODES_SAVE_MSEC (10 * 60 * 1000)
+
+/// Once the node journal grows past this we fold it back into db.proto
+#define NODEDB_JOURNAL_MAX_SIZE (16 * 1024)
+
+/**
+ * Header of each record in the node journal, followed by len bytes of encoded NodeInfo.
+ */
+struct NodeDBJournalRecord {
+    uint16_t len;
+    uint16_t reserved;
+    uint32_t crc; // crc32 of the header (with crc = 0) and payload, a torn record at the end of the journal fails this
+};
+
+namespace concurrency
+{
+class OSThread;
+}
+
 extern DeviceState devicestate;
 extern ChannelFile channelFile;
 extern MyNodeInfo &myNodeInfo;
@@ -43,7 +73,33 @@ class NodeDB
     NodeInfo *nodes;
     pb_size_t *numNodes;
 
-    uint32_t readPointer = 0;
+    /// The change sequence number of each entry in nodes (RAM only, kept parallel to nodes), so clients can fetch just
+    /// the nodes which changed since they last synced
+    uint32_t nodeSeq[MAX_NUM_NODES] = {};
+
+    /// Where our sequence numbers started this boot.  Picked at random, so that a sequence number a client got before we
+    /// rebooted is unlikely to look like one of ours
+    uint32_t bootSeq = 0;
+
+    /// How many changes we have numbered since bootSeq
+    uint32_t numChanges = 0;
+
+    /// SEGMENT_* bits which were changed in RAM but are not yet in flash
+    int dirtySegments = 0;
+
+    /// When the oldest outstanding requestSave() came in, and when we plan to write it
+    uint32_t firstDirtyMsec = 0, saveAtMsec = 0;
+
+    /// getChangeSeq() as of the last time the node list was written, and when that was
+    uint32_t savedChangeSeq = 0, lastNodesSaveMsec = 0;
+
+    /// Bytes in the node journal
+    size_t journalSize = 0;
+
+    /// Does the writing for requestSave()
+    concurrency::OSThread *saveThread = NULL;
+
+    friend class NodeDBSaveThread;
 
   public:
     bool updateGUI = false;            // we think the gui should definitely be redrawn, screen will clear this once handled
@@ -60,6 +116,16 @@ class NodeDB
     /// write to flash
     void saveToDisk(int saveWhat = SEGMENT_CONFIG | SEGMENT_MODULECONFIG | SEGMENT_DEVICESTATE | SEGMENT_CHANNELS), saveChannelsToDisk(), saveDeviceStateToDisk();
 
+    /**
+     * Ask for segments to be written to flash soon.  Requests are coalesced: we wait until none have come in for
+     * NODEDB_SAVE_DEBOUNCE_MSEC (but at most NODEDB_SAVE_MAX_DELAY_MSEC) and then write one file per pass of the main loop.
+     * Use saveToDisk() instead if the data must be in flash when the call returns.
+     */
+    void requestSave(int saveWhat);
+
+    /// Write whatever requestSave() is still holding on to (and the node list if it changed), call before a reboot or power off
+    void flushSaves();
+
     /** Reinit radio config if needed, because either:
      * a) sometimes a buggy android app might send us bogus settings or
      * b) the client set factory_reset
@@ -100,11 +166,17 @@ class NodeDB
     their denial?)
     */
 
-    /// Called from bluetooth when the user wants to start reading the node DB from scratch.
-    void resetReadPointer() { readPointer = 0; }
+    /// Allow a phone API session to read our next nodeinfo record, or NULL if done reading
+    /// @param readIndex the caller's cursor into the DB, start it at 0
+    /// @param sinceSeq only return nodes changed after this (validated) change sequence number, plus our own node
+    const NodeInfo *readNextInfo(uint32_t &readIndex, uint32_t sinceSeq = NODEDB_SEQ_ALL);
+
+    /// The sequence number of our most recent change, a client which has read every node can later ask for just the
+    /// nodes changed after this
+    uint32_t getChangeSeq() const { return (bootSeq + numChanges) & NODEDB_SEQ_MASK; }
 
-    /// Allow the bluetooth layer to read our next nodeinfo record, or NULL if done reading
-    const NodeInfo *readNextInfo();
+    /// @return true if seq is a change sequence number we handed out since boot (and are still able to compare against)
+    bool isValidChangeSeq(uint32_t seq) const;
 
     /// pick a provisional nodenum we hope no one is using
     void pickNewNodeNum();
@@ -132,6 +204,31 @@ class NodeDB
     /// Find a node in our DB, create an empty NodeInfo if missing
     NodeInfo *getOrCreateNode(NodeNum n);
 
+    /// Give a node the next change sequence number, so the next incremental sync will include it
+    void markChanged(const NodeInfo *info);
+
+    /// Forget all change sequence numbers handed out so far (forcing clients back to a full sync), used when nodes are
+    /// removed, because an incremental sync has no way to tell clients about that
+    void restartChangeSeq();
+
+    /// Write the next segment requestSave() asked for if it is due, returns how long until we want to be called again
+    int32_t runSaves();
+
+    /**
+     * Persist the nodes changed since savedChangeSeq.  Normally they are just appended to the node journal, rather than
+     * rewriting all of db.proto, and every so often the journal is folded back in with a full saveDeviceStateToDisk().
+     */
+    void saveNodes();
+
+    /// Append the changed nodes to the node journal, returns false if that didn't work out (and we should save in full)
+    bool journalNodes();
+
+    /// Apply the node journal on top of the db.proto we just loaded
+    void replayJournal();
+
+    /// Apply one node from the journal, unless we already hold newer information about it
+    void replayNode(const NodeInfo &n);
+
     /// Notify observers of changes to the DB
     void notifyObservers(bool forceUpdate = false)
     {
@@ -0,0 +1,78 @@
+#include "configuration.h"
+#include "PBFileStream.h"
+
+#ifdef FSCom
+
+static uint8_t fileBuffer[PB_FILE_BUFFER_SIZE];
+
+PBFileIStream::PBFileIStream(File &f, size_t maxSize) : file(f)
+{
+    // nanopb stops decoding a message cleanly once bytes_left reaches 0, so it must be exactly the bytes in the file
+    size_t size = f.size();
+    stream = {&read, this, (size < maxSize) ? size : maxSize};
+}
+
+bool PBFileIStream::read(pb_istream_t *stream, uint8_t *buf, size_t count)
+{
+    PBFileIStream *s = (PBFileIStream *)stream->state;
+
+    while (count) {
+        if (s->pos == s->len) {
+            // Big reads (long bytes fields) go straight into the caller's buffer
+            if (buf && count >= PB_FILE_BUFFER_SIZE)
+                return s->file.read(buf, count) == (int)count;
+
+            int n = s->file.read(fileBuffer, PB_FILE_BUFFER_SIZE);
+            if (n <= 0)
+                return false;
+            s->pos = 0;
+            s->len = n;
+        }
+
+        size_t n = s->len - s->pos;
+        if (n > count)
+            n = count;
+        if (buf) { // buf is NULL when nanopb is skipping a field
+            memcpy(buf, fileBuffer + s->pos, n);
+            buf += n;
+        }
+        s->pos += n;
+        count -= n;
+    }
+
+    return true;
+}
+
+PBFileOStream::PBFileOStream(File &f, size_t maxSize) : file(f)
+{
+    stream = {&write, this, maxSize};
+}
+
+bool PBFileOStream::write(pb_ostream_t *stream, const uint8_t *buf, size_t count)
+{
+    PBFileOStream *s = (PBFileOStream *)stream->state;
+
+    while (count) {
+        if (s->len == PB_FILE_BUFFER_SIZE && !s->flush())
+            return false;
+
+        size_t n = PB_FILE_BUFFER_SIZE - s->len;
+        if (n > count)
+            n = count;
+        memcpy(fileBuffer + s->len, buf, n);
+        s->len += n;
+        buf += n;
+        count -= n;
+    }
+
+    return true;
+}
+
+bool PBFileOStream::flush()
+{
+    size_t n = len;
+    len = 0;
+    return !n || file.write(fileBuffer, n) == n;
+}
+
+#endif
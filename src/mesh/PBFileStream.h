@@ -0,0 +1,64 @@
+#pragma once
+
+#include "FSCommon.h"
+#include <pb_decode.h>
+#include <pb_encode.h>
+
+/// Bytes of file data we move per filesystem call when reading or writing protobufs, bigger is faster but costs RAM
+#ifndef PB_FILE_BUFFER_SIZE
+#define PB_FILE_BUFFER_SIZE 1024
+#endif
+
+#ifdef FSCom
+
+/**
+ * A block buffered nanopb input stream over a File.  nanopb asks for a few bytes at a time (often a single tag or varint
+ * byte), and a filesystem call for each of those is slow, so we read PB_FILE_BUFFER_SIZE bytes at once instead.
+ *
+ * PBFileIStream and PBFileOStream share one static buffer (prefs are only loaded and saved from the main loop), so only one
+ * of them may be in use at a time.
+ *
+ *     PBFileIStream in(f, protoSize);
+ *     pb_decode(&in.stream, fields, dest_struct);
+ */
+class PBFileIStream
+{
+    File &file;
+    size_t pos = 0, len = 0;
+
+  public:
+    pb_istream_t stream;
+
+    /// Decode from f, reading at most maxSize bytes
+    PBFileIStream(File &f, size_t maxSize);
+
+    PBFileIStream(const PBFileIStream &) = delete;
+
+  private:
+    static bool read(pb_istream_t *stream, uint8_t *buf, size_t count);
+};
+
+/**
+ * A block buffered nanopb output stream over a File, the counterpart of PBFileIStream.  Call flush() once encoding is done.
+ */
+class PBFileOStream
+{
+    File &file;
+    size_t len = 0;
+
+  public:
+    pb_ostream_t stream;
+
+    /// Encode to f, writing at most maxSize bytes
+    PBFileOStream(File &f, size_t maxSize);
+
+    PBFileOStream(const PBFileOStream &) = delete;
+
+    /// Write out whatever is still buffered, returns false if that failed
+    bool flush();
+
+  private:
+    static bool write(pb_ostream_t *stream, const uint8_t *buf, size_t count);
+};
+
+#endif
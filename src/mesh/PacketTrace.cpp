@@ -0,0 +1,189 @@
+#include "configuration.h"
+#include "PacketTrace.h"
+#include "concurrency/LockGuard.h"
+
+PacketTrace packetTrace;
+
+const char *PacketTrace::stageName(PacketTraceStage stage)
+{
+    switch (stage) {
+    case TRACE_RADIO_RX:
+        return "radioRx";
+    case TRACE_ROUTER:
+        return "router";
+    case TRACE_DECODED:
+        return "decoded";
+    case TRACE_TO_PHONE:
+        return "toPhoneQueue";
+    case TRACE_MODULES_DONE:
+        return "modulesDone";
+    case TRACE_PHONE_DRAIN:
+        return "phoneDrain";
+    default:
+        return "unknown";
+    }
+}
+
+uint8_t PacketTrace::bucketFor(uint32_t usec)
+{
+    uint32_t v = usec >> PACKET_TRACE_BUCKET0_SHIFT;
+    uint8_t bucket = 0;
+    while (v && bucket < PACKET_TRACE_BUCKETS - 1) {
+        v >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+PacketTrace::Slot *PacketTrace::findSlot(PacketId id)
+{
+    for (int i = 0; i < PACKET_TRACE_SLOTS; i++)
+        if (slots[i].stampedMask && slots[i].id == id)
+            return &slots[i];
+
+    return NULL;
+}
+
+PacketTrace::Slot *PacketTrace::allocSlot(PacketId id)
+{
+    // Simple round robin, if we have more than PACKET_TRACE_SLOTS packets in flight the oldest trace is recycled
+    Slot &s = slots[nextSlot];
+    nextSlot = (nextSlot + 1) % PACKET_TRACE_SLOTS;
+
+    if (s.stampedMask)
+        finishSlot(s);
+
+    s.id = id;
+    s.stampedMask = 0;
+    return &s;
+}
+
+void PacketTrace::record(PacketId id, PacketTraceStage stage)
+{
+    if (id == 0)
+        return; // Can't key on that
+
+    uint32_t now = micros();
+    bool report = false;
+    {
+        concurrency::LockGuard g(&lock);
+        report = recordLocked(id, stage, now);
+    }
+
+    if (report)
+        logStats();
+}
+
+bool PacketTrace::recordLocked(PacketId id, PacketTraceStage stage, uint32_t now)
+{
+    Slot *s = (stage == TRACE_RADIO_RX) ? NULL : findSlot(id);
+    if (!s) {
+        if (stage == TRACE_PHONE_DRAIN)
+            return false; // We never saw this packet arrive (or its trace was recycled), nothing useful to measure
+        s = allocSlot(id);
+    }
+
+    s->stamps[stage] = now;
+    bool isFirst = !s->stampedMask;
+    s->stampedMask |= (1 << stage);
+
+    if (!isFirst) {
+        // Latency is measured from the first stage we saw, which is TRACE_RADIO_RX for everything that came over LoRa
+        uint32_t start = now;
+        for (int i = 0; i < TRACE_NUM_STAGES; i++)
+            if ((s->stampedMask & (1 << i)) && (int32_t)(s->stamps[i] - start) < 0)
+                start = s->stamps[i];
+
+        uint32_t latency = now - start;
+        histogram[stage][bucketFor(latency)]++;
+        if (latency > maxLatency[stage])
+            maxLatency[stage] = latency;
+    }
+
+    if (stage == TRACE_PHONE_DRAIN) {
+        finishSlot(*s);
+        s->stampedMask = 0;
+
+        return ++numDrained % PACKET_TRACE_REPORT_EVERY == 0;
+    }
+    return false;
+}
+
+void PacketTrace::finishSlot(Slot &s)
+{
+#ifdef ARCH_PORTDUINO
+    if (!traceFile)
+        return;
+
+    // Emit one complete ("X") event per stage, spanning from the previous stage we have a stamp for
+    int prev = -1;
+    for (int i = 0; i < TRACE_NUM_STAGES; i++) {
+        if (!(s.stampedMask & (1 << i)))
+            continue;
+        if (prev >= 0) {
+            int32_t dur = s.stamps[i] - s.stamps[prev];
+            if (dur < 0)
+                dur = 0; // Locally generated packets can visit stages out of the usual order
+            fprintf(traceFile,
+                    "{\"name\":\"%s\",\"cat\":\"packet\",\"ph\":\"X\",\"ts\":%u,\"dur\":%d,\"pid\":1,\"tid\":%u,"
+                    "\"args\":{\"id\":\"0x%x\"}},\n",
+                    stageName((PacketTraceStage)i), s.stamps[prev], dur, s.id % 64, s.id);
+        }
+        prev = i;
+    }
+    fflush(traceFile);
+#endif
+}
+
+void PacketTrace::logStats()
+{
+    concurrency::LockGuard g(&lock);
+
+    LOG_DEBUG("Packet latency (usec since rx), buckets start at %u and double:\n", 1 << PACKET_TRACE_BUCKET0_SHIFT);
+    for (int stage = TRACE_ROUTER; stage < TRACE_NUM_STAGES; stage++) {
+        uint32_t total = 0;
+        for (int b = 0; b < PACKET_TRACE_BUCKETS; b++)
+            total += histogram[stage][b];
+        if (!total)
+            continue;
+
+        // Walk the histogram to find the bucket holding the median and 95th percentile
+        uint32_t seen = 0;
+        int p50 = -1, p95 = -1;
+        for (int b = 0; b < PACKET_TRACE_BUCKETS; b++) {
+            seen += histogram[stage][b];
+            if (p50 < 0 && seen * 2 >= total)
+                p50 = b;
+            if (p95 < 0 && seen * 100 >= total * 95)
+                p95 = b;
+        }
+        LOG_DEBUG("  %s: n=%u, p50<%u, p95<%u, max=%u\n", stageName((PacketTraceStage)stage), total,
+                  1 << (PACKET_TRACE_BUCKET0_SHIFT + p50), 1 << (PACKET_TRACE_BUCKET0_SHIFT + p95), maxLatency[stage]);
+    }
+}
+
+void PacketTrace::reset()
+{
+    concurrency::LockGuard g(&lock);
+
+    memset(slots, 0, sizeof(slots));
+    memset(histogram, 0, sizeof(histogram));
+    memset(maxLatency, 0, sizeof(maxLatency));
+    nextSlot = 0;
+    numDrained = 0;
+}
+
+#ifdef ARCH_PORTDUINO
+bool PacketTrace::openChromeTrace(const char *path)
+{
+    traceFile = fopen(path, "w");
+    if (!traceFile) {
+        printf("Can't open trace file %s\n", path); // Called while parsing args, before the console exists
+        return false;
+    }
+
+    // The JSON array format doesn't need the closing bracket, so we can just keep appending events until we exit
+    fprintf(traceFile, "[\n");
+    return true;
+}
+#endif
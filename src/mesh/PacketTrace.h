@@ -0,0 +1,106 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include "concurrency/Lock.h"
+#include <Arduino.h>
+
+#ifdef ARCH_PORTDUINO
+#include <stdio.h>
+#endif
+
+/// Number of packets we can follow through the pipeline at once, older traces are recycled
+#define PACKET_TRACE_SLOTS 16
+
+/// Latency histogram buckets, bucket 0 is < 64us, each following bucket doubles (last bucket is everything >= ~4s)
+#define PACKET_TRACE_BUCKETS 18
+#define PACKET_TRACE_BUCKET0_SHIFT 6
+
+/// Log a summary of the histograms every time this many packets have reached the phone
+#define PACKET_TRACE_REPORT_EVERY 32
+
+/**
+ * The places in the receive pipeline we timestamp.  Stages are listed in the order a packet normally visits them, but
+ * note that TRACE_TO_PHONE happens _inside_ the module dispatch (the RoutingModule hands the packet to MeshService).
+ */
+enum PacketTraceStage {
+    TRACE_RADIO_RX,      // RadioLibInterface::handleReceiveInterrupt has read the packet from the chip
+    TRACE_ROUTER,        // Router pulled it from fromRadioQueue and started perhapsHandleReceived
+    TRACE_DECODED,       // perhapsDecode finished (successfully or not)
+    TRACE_TO_PHONE,      // MeshService::sendToPhone is about to put a copy in toPhoneQueue
+    TRACE_MODULES_DONE,  // MeshModule::callPlugins returned
+    TRACE_PHONE_DRAIN,   // PhoneAPI::getFromRadio handed the packet to a client
+    TRACE_NUM_STAGES
+};
+
+/**
+ * Lightweight per packet latency tracing through the RX -> router -> module -> phone pipeline.
+ *
+ * Each stage records a micros() timestamp in a small side table keyed by packet id.  Every time a stage is recorded we
+ * add the latency since TRACE_RADIO_RX (or the first stage we saw for that packet) to a per stage log2 histogram.
+ *
+ * On native builds the completed traces can also be written as Chrome/Perfetto trace-event JSON (see openChromeTrace).
+ *
+ * Stages are recorded from both the main loop and the BLE task (TRACE_PHONE_DRAIN), so the tables are guarded by a lock.
+ */
+class PacketTrace
+{
+    struct Slot {
+        PacketId id;
+        uint8_t stampedMask; // bit per PacketTraceStage that has a valid timestamp
+        uint32_t stamps[TRACE_NUM_STAGES];
+    };
+
+    Slot slots[PACKET_TRACE_SLOTS] = {};
+    uint8_t nextSlot = 0;
+
+    /// histogram[stage][bucket] of the time (in usec) from the first recorded stage to this stage
+    uint32_t histogram[TRACE_NUM_STAGES][PACKET_TRACE_BUCKETS] = {};
+
+    /// Worst latency (usec) we've seen for each stage
+    uint32_t maxLatency[TRACE_NUM_STAGES] = {};
+
+    uint32_t numDrained = 0;
+
+    concurrency::Lock lock;
+
+#ifdef ARCH_PORTDUINO
+    FILE *traceFile = NULL;
+#endif
+
+  public:
+    /// Record that packet id has reached stage
+    void record(PacketId id, PacketTraceStage stage);
+
+    /// Print the per stage histograms to the debug log
+    void logStats();
+
+    /// Forget all histograms and in flight traces
+    void reset();
+
+    static const char *stageName(PacketTraceStage stage);
+
+#ifdef ARCH_PORTDUINO
+    /// Start writing completed traces to path in Chrome trace-event JSON format (viewable in chrome://tracing or Perfetto)
+    bool openChromeTrace(const char *path);
+#endif
+
+  private:
+    Slot *findSlot(PacketId id);
+    Slot *allocSlot(PacketId id);
+
+    /// The body of record, with the lock held, returns true if it is time to logStats
+    bool recordLocked(PacketId id, PacketTraceStage stage, uint32_t now);
+
+    /// A trace is done (reached the phone or got recycled), emit it to the trace file if we have one
+    void finishSlot(Slot &s);
+
+    static uint8_t bucketFor(uint32_t usec);
+};
+
+extern PacketTrace packetTrace;
+
+#ifndef PACKET_TRACE_DISABLED
+#define PACKET_TRACE(id, stage) packetTrace.record(id, stage)
+#else
+#define PACKET_TRACE(id, stage)
+#endif
@@ -3,9 +3,13 @@
 #include "GPS.h"
 #include "MeshService.h"
 #include "NodeDB.h"
+#include "PacketTrace.h"
 #include "PowerFSM.h"
+#include "RTC.h"
 #include "RadioInterface.h"
+#include "concurrency/LockGuard.h"
 #include "configuration.h"
+#include <ErriezCRC32.h>
 
 #if FromRadio_size > MAX_TO_FROM_RADIO_SIZE
 #error FromRadio is too big
@@ -15,6 +19,190 @@
 #error ToRadio is too big
 #endif
 
+/// The handshake records we send between nodeinfos and config_complete_id: every channel, then every Config, then every
+/// ModuleConfig
+#define NUM_CONFIG_TYPES (_AdminMessage_ConfigType_MAX - _AdminMessage_ConfigType_MIN + 1)
+#define NUM_MODULECONFIG_TYPES (_AdminMessage_ModuleConfigType_MAX - _AdminMessage_ModuleConfigType_MIN + 1)
+#define NUM_CONFIG_RECORDS (MAX_NUM_CHANNELS + NUM_CONFIG_TYPES + NUM_MODULECONFIG_TYPES)
+
+bool PhoneAPI::configCacheValid = false;
+
+/// Set if the config didn't fit in configCache, so we encode on the fly until it is next invalidated instead of retrying
+static bool configCacheTooSmall = false;
+
+/// The cache is rebuilt and read by whichever API needs it, and the BLE APIs run in the NimBLE host task
+static concurrency::Lock configCacheLock;
+
+/// Every config record, already encoded as FromRadio protobufs, back to back.  Rebuilt on demand after invalidateConfigCache
+static uint8_t configCache[PHONEAPI_CONFIG_CACHE_SIZE];
+
+/// configCache offset of each record (with one extra entry marking the end of the last record)
+static uint16_t configCacheOffsets[NUM_CONFIG_RECORDS + 1];
+
+/// Fill in the FromRadio for config record number record
+static void fillConfigRecord(uint8_t record, FromRadio &fr)
+{
+    memset(&fr, 0, sizeof(fr));
+
+    if (record < MAX_NUM_CHANNELS) {
+        fr.which_payload_variant = FromRadio_channel_tag;
+        fr.channel = channels.getByIndex(record);
+        return;
+    }
+    record -= MAX_NUM_CHANNELS;
+
+    if (record < NUM_CONFIG_TYPES) {
+        uint8_t tag = record + _AdminMessage_ConfigType_MIN + 1;
+        fr.which_payload_variant = FromRadio_config_tag;
+        switch (tag) {
+        case Config_device_tag:
+            fr.config.which_payload_variant = Config_device_tag;
+            fr.config.payload_variant.device = config.device;
+            break;
+        case Config_position_tag:
+            fr.config.which_payload_variant = Config_position_tag;
+            fr.config.payload_variant.position = config.position;
+            break;
+        case Config_power_tag:
+            fr.config.which_payload_variant = Config_power_tag;
+            fr.config.payload_variant.power = config.power;
+            fr.config.payload_variant.power.ls_secs = default_ls_secs;
+            break;
+        case Config_network_tag:
+            fr.config.which_payload_variant = Config_network_tag;
+            fr.config.payload_variant.network = config.network;
+            break;
+        case Config_display_tag:
+            fr.config.which_payload_variant = Config_display_tag;
+            fr.config.payload_variant.display = config.display;
+            break;
+        case Config_lora_tag:
+            fr.config.which_payload_variant = Config_lora_tag;
+            fr.config.payload_variant.lora = config.lora;
+            break;
+        case Config_bluetooth_tag:
+            fr.config.which_payload_variant = Config_bluetooth_tag;
+            fr.config.payload_variant.bluetooth = config.bluetooth;
+            break;
+        default:
+            LOG_ERROR("Unknown config type %d\n", tag);
+        }
+        // NOTE: The phone app needs to know the ls_secs value so it can properly expect sleep behavior.
+        // So even if we internally use 0 to represent 'use default' we still need to send the value we are
+        // using to the app (so that even old phone apps work with new device loads).
+        return;
+    }
+    record -= NUM_CONFIG_TYPES;
+
+    uint8_t tag = record + _AdminMessage_ModuleConfigType_MIN + 1;
+    fr.which_payload_variant = FromRadio_moduleConfig_tag;
+    switch (tag) {
+    case ModuleConfig_mqtt_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_mqtt_tag;
+        fr.moduleConfig.payload_variant.mqtt = moduleConfig.mqtt;
+        break;
+    case ModuleConfig_serial_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_serial_tag;
+        fr.moduleConfig.payload_variant.serial = moduleConfig.serial;
+        break;
+    case ModuleConfig_external_notification_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_external_notification_tag;
+        fr.moduleConfig.payload_variant.external_notification = moduleConfig.external_notification;
+        break;
+    case ModuleConfig_store_forward_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_store_forward_tag;
+        fr.moduleConfig.payload_variant.store_forward = moduleConfig.store_forward;
+        break;
+    case ModuleConfig_range_test_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_range_test_tag;
+        fr.moduleConfig.payload_variant.range_test = moduleConfig.range_test;
+        break;
+    case ModuleConfig_telemetry_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_telemetry_tag;
+        fr.moduleConfig.payload_variant.telemetry = moduleConfig.telemetry;
+        break;
+    case ModuleConfig_canned_message_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_canned_message_tag;
+        fr.moduleConfig.payload_variant.canned_message = moduleConfig.canned_message;
+        break;
+    case ModuleConfig_audio_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_audio_tag;
+        fr.moduleConfig.payload_variant.audio = moduleConfig.audio;
+        break;
+    case ModuleConfig_remote_hardware_tag:
+        fr.moduleConfig.which_payload_variant = ModuleConfig_remote_hardware_tag;
+        fr.moduleConfig.payload_variant.remote_hardware = moduleConfig.remote_hardware;
+        break;
+    default:
+        LOG_ERROR("Unknown module config type %d\n", tag);
+    }
+}
+
+void PhoneAPI::invalidateConfigCache()
+{
+    concurrency::LockGuard g(&configCacheLock);
+    configCacheValid = false;
+    configCacheTooSmall = false;
+}
+
+void PhoneAPI::rebuildConfigCache()
+{
+    static FromRadio scratch; // Too big to want on the stack
+
+    size_t len = 0;
+    for (uint8_t r = 0; r < NUM_CONFIG_RECORDS; r++) {
+        configCacheOffsets[r] = len;
+        fillConfigRecord(r, scratch);
+
+        size_t size;
+        if (!pb_get_encoded_size(&size, &FromRadio_msg, &scratch) || len + size > sizeof(configCache)) {
+            LOG_WARN("PHONEAPI_CONFIG_CACHE_SIZE is too small, encoding config on the fly\n");
+            configCacheTooSmall = true;
+            return;
+        }
+        len += pb_encode_to_bytes(configCache + len, size, &FromRadio_msg, &scratch);
+    }
+    configCacheOffsets[NUM_CONFIG_RECORDS] = len;
+    configCacheValid = true;
+
+    LOG_DEBUG("Config cache rebuilt, %u bytes\n", len);
+}
+
+size_t PhoneAPI::getConfigRecord(uint8_t *buf)
+{
+    size_t numbytes = 0;
+    {
+        concurrency::LockGuard g(&configCacheLock);
+        if (!configCacheValid && !configCacheTooSmall)
+            rebuildConfigCache();
+
+        if (configCacheValid) {
+            numbytes = configCacheOffsets[config_state + 1] - configCacheOffsets[config_state];
+            memcpy(buf, configCache + configCacheOffsets[config_state], numbytes);
+        }
+    }
+
+    if (!numbytes) {
+        fillConfigRecord(config_state, fromRadioScratch);
+        numbytes = pb_encode_to_bytes(buf, FromRadio_size, &FromRadio_msg, &fromRadioScratch);
+    }
+
+    config_state++;
+    // Advance when we have sent all of our channels, Config and ModuleConfig objects
+    if (config_state >= NUM_CONFIG_RECORDS) {
+        state = STATE_SEND_COMPLETE_ID;
+        config_state = 0;
+    }
+    return numbytes;
+}
+
+/// The check byte of the sync token for NodeDB change sequence number seq
+static uint8_t syncTokenCheck(uint32_t seq)
+{
+    uint32_t key[2] = {seq, nodeDB.getNodeNum()};
+    return crc32Buffer(key, sizeof(key)) & 0xff;
+}
+
 PhoneAPI::PhoneAPI()
 {
     lastContactMsec = millis();
@@ -37,9 +225,29 @@ void PhoneAPI::handleStartConfig()
     state = STATE_SEND_MY_INFO;
 
     LOG_INFO("Starting API client config\n");
-    nodeInfoForPhone = NULL;   // Don't keep returning old nodeinfos
-    nodeDB.resetReadPointer(); // FIXME, this read pointer should be moved out of nodeDB and into this class - because
-                               // this will break once we have multiple instances of PhoneAPI running independently
+    nodeInfoForPhone = NULL; // Don't keep returning old nodeinfos
+    nodeInfoReadIndex = 0;
+    numDroppedReported = 0; // Tell each new session about anything lost since boot
+
+    // Clients which kept our nodes from an earlier session can ask for just the ones which changed since
+    nodeInfoSinceSeq = NODEDB_SEQ_ALL;
+    wantsSyncToken = false;
+    if (config_nonce == PHONEAPI_WANT_CONFIG_SYNC) {
+        LOG_INFO("Client opted in to incremental NodeDB syncs\n");
+        wantsSyncToken = true;
+    } else if ((config_nonce & 0xff) == syncTokenCheck(config_nonce >> 8)) {
+        // Only take it as a token if we handed it out, a legacy client's nonce which happened to pass the check still gets
+        // its own nonce back
+        uint32_t since = config_nonce >> 8;
+        if (nodeDB.isValidChangeSeq(since)) {
+            LOG_INFO("Sending nodeinfos changed since seq %u\n", since);
+            nodeInfoSinceSeq = since;
+            wantsSyncToken = true;
+        } else {
+            LOG_INFO("Unknown NodeDB seq %u, sending all nodeinfos\n", since);
+        }
+    }
+    configChangeSeq = nodeDB.getChangeSeq();
 }
 
 void PhoneAPI::close()
@@ -122,6 +330,13 @@ size_t PhoneAPI::getFromRadio(uint8_t *buf)
         // LOG_DEBUG("getFromRadio=not available\n");
         return 0;
     }
+
+    // Channels and config are copied straight out of the encoded cache, nothing to build
+    if (state == STATE_SEND_CONFIG) {
+        LOG_INFO("getFromRadio=STATE_SEND_CONFIG\n");
+        return getConfigRecord(buf);
+    }
+
     // In case we send a FromRadio packet
     memset(&fromRadioScratch, 0, sizeof(fromRadioScratch));
 
@@ -156,129 +371,20 @@ size_t PhoneAPI::getFromRadio(uint8_t *buf)
             // Stay in current state until done sending nodeinfos
         } else {
             LOG_INFO("Done sending nodeinfos\n");
-            state = STATE_SEND_CHANNELS;
+            state = STATE_SEND_CONFIG;
+            config_state = 0;
             // Go ahead and send that ID right now
             return getFromRadio(buf);
         }
         break;
     }
 
-    case STATE_SEND_CHANNELS:
-        LOG_INFO("getFromRadio=STATE_SEND_CHANNELS\n");
-        fromRadioScratch.which_payload_variant = FromRadio_channel_tag;
-        fromRadioScratch.channel = channels.getByIndex(config_state);
-        config_state++;
-        // Advance when we have sent all of our Channels
-        if (config_state >= MAX_NUM_CHANNELS) {
-            state = STATE_SEND_CONFIG;
-            config_state = _AdminMessage_ConfigType_MIN + 1;
-        }
-        break;
-
-    case STATE_SEND_CONFIG:
-        LOG_INFO("getFromRadio=STATE_SEND_CONFIG\n");
-        fromRadioScratch.which_payload_variant = FromRadio_config_tag;
-        switch (config_state) {
-        case Config_device_tag:
-            fromRadioScratch.config.which_payload_variant = Config_device_tag;
-            fromRadioScratch.config.payload_variant.device = config.device;
-            break;
-        case Config_position_tag:
-            fromRadioScratch.config.which_payload_variant = Config_position_tag;
-            fromRadioScratch.config.payload_variant.position = config.position;
-            break;
-        case Config_power_tag:
-            fromRadioScratch.config.which_payload_variant = Config_power_tag;
-            fromRadioScratch.config.payload_variant.power = config.power;
-            fromRadioScratch.config.payload_variant.power.ls_secs = default_ls_secs;
-            break;
-        case Config_network_tag:
-            fromRadioScratch.config.which_payload_variant = Config_network_tag;
-            fromRadioScratch.config.payload_variant.network = config.network;
-            break;
-        case Config_display_tag:
-            fromRadioScratch.config.which_payload_variant = Config_display_tag;
-            fromRadioScratch.config.payload_variant.display = config.display;
-            break;
-        case Config_lora_tag:
-            fromRadioScratch.config.which_payload_variant = Config_lora_tag;
-            fromRadioScratch.config.payload_variant.lora = config.lora;
-            break;
-        case Config_bluetooth_tag:
-            fromRadioScratch.config.which_payload_variant = Config_bluetooth_tag;
-            fromRadioScratch.config.payload_variant.bluetooth = config.bluetooth;
-            break;
-        default:
-            LOG_ERROR("Unknown config type %d\n", config_state);
-        }
-        // NOTE: The phone app needs to know the ls_secs value so it can properly expect sleep behavior.
-        // So even if we internally use 0 to represent 'use default' we still need to send the value we are
-        // using to the app (so that even old phone apps work with new device loads).
-
-        config_state++;
-        // Advance when we have sent all of our config objects
-        if (config_state > (_AdminMessage_ConfigType_MAX + 1)) {
-            state = STATE_SEND_MODULECONFIG;
-            config_state = _AdminMessage_ModuleConfigType_MIN + 1;
-        }
-        break;
-
-    case STATE_SEND_MODULECONFIG:
-        LOG_INFO("getFromRadio=STATE_SEND_MODULECONFIG\n");
-        fromRadioScratch.which_payload_variant = FromRadio_moduleConfig_tag;
-        switch (config_state) {
-        case ModuleConfig_mqtt_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_mqtt_tag;
-            fromRadioScratch.moduleConfig.payload_variant.mqtt = moduleConfig.mqtt;
-            break;
-        case ModuleConfig_serial_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_serial_tag;
-            fromRadioScratch.moduleConfig.payload_variant.serial = moduleConfig.serial;
-            break;
-        case ModuleConfig_external_notification_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_external_notification_tag;
-            fromRadioScratch.moduleConfig.payload_variant.external_notification = moduleConfig.external_notification;
-            break;
-        case ModuleConfig_store_forward_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_store_forward_tag;
-            fromRadioScratch.moduleConfig.payload_variant.store_forward = moduleConfig.store_forward;
-            break;
-        case ModuleConfig_range_test_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_range_test_tag;
-            fromRadioScratch.moduleConfig.payload_variant.range_test = moduleConfig.range_test;
-            break;
-        case ModuleConfig_telemetry_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_telemetry_tag;
-            fromRadioScratch.moduleConfig.payload_variant.telemetry = moduleConfig.telemetry;
-            break;
-        case ModuleConfig_canned_message_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_canned_message_tag;
-            fromRadioScratch.moduleConfig.payload_variant.canned_message = moduleConfig.canned_message;
-            break;
-        case ModuleConfig_audio_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_audio_tag;
-            fromRadioScratch.moduleConfig.payload_variant.audio = moduleConfig.audio;
-            break;
-        case ModuleConfig_remote_hardware_tag:
-            fromRadioScratch.moduleConfig.which_payload_variant = ModuleConfig_remote_hardware_tag;
-            fromRadioScratch.moduleConfig.payload_variant.remote_hardware = moduleConfig.remote_hardware;
-            break;
-        default:
-            LOG_ERROR("Unknown module config type %d\n", config_state);
-        }
-
-        config_state++;
-        // Advance when we have sent all of our ModuleConfig objects
-        if (config_state > (_AdminMessage_ModuleConfigType_MAX + 1)) {
-            state = STATE_SEND_COMPLETE_ID;
-            config_state = 0;
-        }
-        break;
-
     case STATE_SEND_COMPLETE_ID:
         LOG_INFO("getFromRadio=STATE_SEND_COMPLETE_ID\n");
         fromRadioScratch.which_payload_variant = FromRadio_config_complete_id_tag;
-        fromRadioScratch.config_complete_id = config_nonce;
+        // A client doing incremental syncs gets what to ask for next time to get just the nodes changed after this download
+        fromRadioScratch.config_complete_id =
+            wantsSyncToken ? (configChangeSeq << 8) | syncTokenCheck(configChangeSeq) : config_nonce;
         config_nonce = 0;
         state = STATE_SEND_PACKETS;
         break;
@@ -291,8 +397,18 @@ size_t PhoneAPI::getFromRadio(uint8_t *buf)
             fromRadioScratch.which_payload_variant = FromRadio_queueStatus_tag;
             fromRadioScratch.queueStatus = *queueStatusPacketForPhone;
             releaseQueueStatusPhonePacket();
+        } else if (getNumDroppedForPhone() != numDroppedReported) {
+            // There's no dedicated message for this, so let the client know with a log record
+            numDroppedReported = getNumDroppedForPhone();
+            fromRadioScratch.which_payload_variant = FromRadio_log_record_tag;
+            LogRecord &r = fromRadioScratch.log_record;
+            snprintf(r.message, sizeof(r.message), "%u packets for the client were dropped since boot", numDroppedReported);
+            strncpy(r.source, "tophone", sizeof(r.source) - 1);
+            r.level = LogRecord_Level_WARNING;
+            r.time = getValidTime(RTCQualityFromNet);
         } else if (packetForPhone) {
             printPacket("phone downloaded packet", packetForPhone);
+            PACKET_TRACE(packetForPhone->id, TRACE_PHONE_DRAIN);
 
             // Encapsulate as a FromRadio packet
             fromRadioScratch.which_payload_variant = FromRadio_packet_tag;
@@ -323,6 +439,16 @@ void PhoneAPI::handleDisconnect()
     LOG_INFO("PhoneAPI disconnect\n");
 }
 
+MeshPacket *PhoneAPI::getNextPacketForPhone()
+{
+    return service.getForPhone();
+}
+
+uint32_t PhoneAPI::getNumDroppedForPhone()
+{
+    return service.getNumDroppedForPhone() + numDropped;
+}
+
 void PhoneAPI::releasePhonePacket()
 {
     if (packetForPhone) {
@@ -348,14 +474,12 @@ bool PhoneAPI::available()
     case STATE_SEND_NOTHING:
         return false;
     case STATE_SEND_MY_INFO:
-    case STATE_SEND_CHANNELS:
     case STATE_SEND_CONFIG:
-    case STATE_SEND_MODULECONFIG:
     case STATE_SEND_COMPLETE_ID:
         return true;
     case STATE_SEND_NODEINFO:
         if (!nodeInfoForPhone)
-            nodeInfoForPhone = nodeDB.readNextInfo();
+            nodeInfoForPhone = nodeDB.readNextInfo(nodeInfoReadIndex, nodeInfoSinceSeq);
         return true; // Always say we have something, because we might need to advance our state machine
 
     case STATE_SEND_PACKETS: {
@@ -365,8 +489,11 @@ bool PhoneAPI::available()
         if (hasPacket)
             return true;
 
+        if (getNumDroppedForPhone() != numDroppedReported)
+            return true;
+
         if (!packetForPhone)
-            packetForPhone = service.getForPhone();
+            packetForPhone = getNextPacketForPhone();
         hasPacket = !!packetForPhone;
         // LOG_DEBUG("available hasPacket=%d\n", hasPacket);
         return hasPacket;
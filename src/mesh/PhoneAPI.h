@@ -1,5 +1,6 @@
 #pragma once
 
+#include "NodeDB.h"
 #include "Observer.h"
 #include "mesh-pb-constants.h"
 #include <string>
@@ -7,6 +8,23 @@
 // Make sure that we never let our packets grow too large for one BLE packet
 #define MAX_TO_FROM_RADIO_SIZE 512
 
+// Room for every channel, Config and ModuleConfig record encoded as FromRadios (currently about 1.6KB)
+#ifndef PHONEAPI_CONFIG_CACHE_SIZE
+#define PHONEAPI_CONFIG_CACHE_SIZE 2048
+#endif
+
+/**
+ * Clients which keep our node list between sessions can avoid downloading all of it every time.  Such a client opts in by
+ * sending this as its want_config_id: it gets the usual full download, but the config_complete_id which ends it is a sync
+ * token instead of the nonce.  Sending that token as a later want_config_id asks for just the nodes changed since, and
+ * the config_complete_id of that download is the next token.
+ *
+ * A token is the NodeDB change sequence number in the top 24 bits and a check byte derived from it, so an ordinary random
+ * nonce is practically never taken for one.  A token we can't honor (say we rebooted since) gets a full download ending
+ * with the token itself as config_complete_id, like any other nonce, and the client should then opt in again.
+ */
+#define PHONEAPI_WANT_CONFIG_SYNC 0x53594e43 // "SYNC"
+
 /**
  * Provides our protobuf based API which phone/PC clients can use to talk to our device
  * over UDP, bluetooth or serial.
@@ -22,9 +40,7 @@ class PhoneAPI : public Observer<uint32_t> // FIXME, we shouldn't be inheriting
         STATE_SEND_NOTHING, // Initial state, don't send anything until the client starts asking for config
         STATE_SEND_MY_INFO, // send our my info record
         STATE_SEND_NODEINFO, // states progress in this order as the device sends to to the client
-        STATE_SEND_CHANNELS, // Send all channels
-        STATE_SEND_CONFIG, // Replacement for the old Radioconfig
-        STATE_SEND_MODULECONFIG, // Send Module specific config
+        STATE_SEND_CONFIG, // Send all channels, then config, then module specific config (from the encoded config cache)
         STATE_SEND_COMPLETE_ID,
         STATE_SEND_PACKETS // send packets or debug strings
     };
@@ -48,11 +64,29 @@ class PhoneAPI : public Observer<uint32_t> // FIXME, we shouldn't be inheriting
     /// We temporarily keep the nodeInfo here between the call to available and getFromRadio
     const NodeInfo *nodeInfoForPhone = NULL;
 
+    /// Our position in the NodeDB while sending nodeinfos (each session has its own, so clients can configure concurrently)
+    uint32_t nodeInfoReadIndex = 0;
+
+    /// Only send nodeinfos changed after this NodeDB change sequence number (NODEDB_SEQ_ALL for a full sync)
+    uint32_t nodeInfoSinceSeq = NODEDB_SEQ_ALL;
+
+    /// The NodeDB change sequence number when this config download started
+    uint32_t configChangeSeq = 0;
+
+    /// true if the client opted in to incremental syncs, so gets a sync token as its config_complete_id
+    bool wantsSyncToken = false;
+
+    /// The dropped packet count we last told this client about
+    uint32_t numDroppedReported = 0;
+
     ToRadio toRadioScratch = {0}; // this is a static scratch object, any data must be copied elsewhere before returning
 
     /// Use to ensure that clients don't get confused about old messages from the radio
     uint32_t config_nonce = 0;
 
+    /// false if the channels or config changed since we last encoded the config cache
+    static bool configCacheValid;
+
   public:
     PhoneAPI();
 
@@ -84,6 +118,12 @@ class PhoneAPI : public Observer<uint32_t> // FIXME, we shouldn't be inheriting
 
     bool isConnected() { return state != STATE_SEND_NOTHING; }
 
+    /// Channels or config have changed, re-encode them before the next client handshake needs them
+    static void invalidateConfigCache();
+
+    /// true once the client has finished downloading our config and is only receiving packets
+    bool isSendingPackets() { return state == STATE_SEND_PACKETS; }
+
     void setInitialState() { state = STATE_SEND_MY_INFO; }
 
   protected:
@@ -92,6 +132,9 @@ class PhoneAPI : public Observer<uint32_t> // FIXME, we shouldn't be inheriting
 
     /** the last msec we heard from the client on the other side of this link */
     uint32_t lastContactMsec = 0;
+
+    /// Packets for this client which its transport had to discard (see getNumDroppedForPhone)
+    uint32_t numDropped = 0;
     
     /// Hookable to find out when connection changes
     virtual void onConnectionChanged(bool connected) {}
@@ -112,11 +155,29 @@ class PhoneAPI : public Observer<uint32_t> // FIXME, we shouldn't be inheriting
      */
     virtual void handleDisconnect();
 
+    /**
+     * Where we get the next mesh packet for the client.  By default that is the shared MeshService queue, transports with
+     * several concurrent sessions give each session its own queue instead.  The returned packet is freed to packetPool.
+     */
+    virtual MeshPacket *getNextPacketForPhone();
+
+    /**
+     * All the packets this client has missed since boot because nobody collected them in time.  By default that is ours
+     * plus those the shared MeshService queue dropped, transports which override getNextPacketForPhone only count their own.
+     */
+    virtual uint32_t getNumDroppedForPhone();
+
   private:
     void releasePhonePacket();
 
     void releaseQueueStatusPhonePacket();
 
+    /// Encode every channel/Config/ModuleConfig record into the shared config cache, caller must hold configCacheLock
+    static void rebuildConfigCache();
+
+    /// Copy config record number config_state into buf and advance our state, returns its length
+    size_t getConfigRecord(uint8_t *buf);
+
     /// begin a new connection
     void handleStartConfig();
 
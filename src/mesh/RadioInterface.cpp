@@ -3,6 +3,7 @@
 #include "MeshRadio.h"
 #include "MeshService.h"
 #include "NodeDB.h"
+#include "PacketTrace.h"
 #include "Router.h"
 #include "configuration.h"
 #include "main.h"
@@ -477,6 +478,7 @@ void RadioInterface::limitPower()
 
 void RadioInterface::deliverToReceiver(MeshPacket *p)
 {
+    PACKET_TRACE(p->id, TRACE_RADIO_RX);
     if (router)
         router->enqueueReceivedMessage(p);
 }
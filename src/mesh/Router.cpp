@@ -3,6 +3,7 @@
 #include "CryptoEngine.h"
 #include "NodeDB.h"
 #include "MeshRadio.h"
+#include "PacketTrace.h"
 #include "RTC.h"
 #include "configuration.h"
 #include "main.h"
@@ -89,6 +90,51 @@ void Router::enqueueReceivedMessage(MeshPacket *p)
     }
 }
 
+void Router::enqueueReceivedMqttMessage(MeshPacket *p)
+{
+    if (isDuplicate(p)) {
+        printPacket("Ignoring MQTT packet, because we've already seen it", p);
+        packetPool.release(p);
+        return;
+    }
+
+    // Keep the encrypted bytes if we will be flooding this, decoding overwrites them
+    MeshPacket *forward = NULL;
+    if (p->which_payload_variant == MeshPacket_encrypted_tag && shouldRebroadcast(p))
+        forward = packetPool.allocCopy(*p);
+
+    // ignore messages if we don't have the channel key
+    if (!perhapsDecode(p)) {
+        packetPool.release(p);
+        if (forward)
+            packetPool.release(forward);
+        return;
+    }
+
+    // Traceroutes need to be decoded so we can add ourselves to the route, let the regular flooding path handle them
+    if (forward && p->decoded.portnum == PortNum_TRACEROUTE_APP) {
+        packetPool.release(forward);
+        forward = NULL;
+    }
+
+    if (forward) {
+        if (airTime->isTxAllowedChannelUtil(true) && airTime->isTxAllowedAirUtil()) {
+            forward->hop_limit--;
+            printPacket("Forwarding MQTT packet as is", forward);
+            // Not our hooked version of send(), this isn't a packet we originated
+            Router::send(forward);
+        } else {
+            LOG_WARN("Airtime budget used up, not flooding MQTT packet 0x%x\n", p->id);
+            packetPool.release(forward);
+        }
+
+        // We've either flooded it already or decided not to, don't let the normal receive path flood it again
+        p->hop_limit = 0;
+    }
+
+    enqueueReceivedMessage(p);
+}
+
 /// Generate a unique packet id
 // FIXME, move this someplace better
 PacketId generatePacketId()
@@ -151,6 +197,10 @@ void Router::setReceivedMessage()
 
 QueueStatus Router::getQueueStatus()
 {
+    if (!iface) {
+        QueueStatus qs = QueueStatus_init_zero;
+        return qs;
+    }
     return iface->getQueueStatus();
 }
 
@@ -445,6 +495,7 @@ void Router::handleReceived(MeshPacket *p, RxSource src)
 
     // Take those raw bytes and convert them back into a well structured protobuf we can understand
     bool decoded = perhapsDecode(p);
+    PACKET_TRACE(p->id, TRACE_DECODED);
     if (decoded) {
         // parsing was successful, queue for our recipient
         if (src == RX_SRC_LOCAL)
@@ -459,10 +510,13 @@ void Router::handleReceived(MeshPacket *p, RxSource src)
 
     // call modules here
     MeshModule::callPlugins(*p, src);
+    PACKET_TRACE(p->id, TRACE_MODULES_DONE);
 }
 
 void Router::perhapsHandleReceived(MeshPacket *p)
 {
+    PACKET_TRACE(p->id, TRACE_ROUTER);
+
     // assert(radioConfig.has_preferences);
     bool ignore = is_in_repeated(config.lora.ignore_incoming, p->from);
 
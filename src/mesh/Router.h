@@ -73,6 +73,15 @@ class Router : protected concurrency::OSThread
      */
     void enqueueReceivedMessage(MeshPacket *p);
 
+    /**
+     * Queue a packet that arrived from an MQTT broker.  These are usually still encrypted exactly as their original sender put
+     * them on the air, so if the packet needs flooding we forward those bytes as is (no decrypt/re-encrypt round trip, and only
+     * if the airtime budget allows) and decode a copy for local delivery.  Duplicates are dropped before any of that.
+     *
+     * The router is now responsible for freeing the packet
+     */
+    void enqueueReceivedMqttMessage(MeshPacket *p);
+
   protected:
     friend class RoutingModule;
 
@@ -95,6 +104,18 @@ class Router : protected concurrency::OSThread
      */
     virtual bool shouldFilterReceived(const MeshPacket *p) { return false; }
 
+    /**
+     * Have we already handled this packet?  Unlike shouldFilterReceived this has no side effects, it lets ingestion paths
+     * drop duplicates before spending any time decoding them.
+     */
+    virtual bool isDuplicate(const MeshPacket *p) { return false; }
+
+    /**
+     * Should this received packet be flooded on to our neighbors?  Only looks at the packet header, so it works on packets
+     * which are still encrypted.
+     */
+    virtual bool shouldRebroadcast(const MeshPacket *p) { return false; }
+
     /**
      * Every (non duplicate) packet this node receives will be passed through this method.  This allows subclasses to
      * update routing tables etc... based on what we overhear (even for messages not destined to our node)
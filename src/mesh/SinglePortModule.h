@@ -23,6 +23,8 @@ class SinglePortModule : public MeshModule
      */
     virtual bool wantPacket(const MeshPacket *p) override { return p->decoded.portnum == ourPortNum; }
 
+    virtual bool wantPortNum(PortNum portnum) override { return portnum == ourPortNum; }
+
     /**
      * Return a mesh packet which has been preinited as a data packet with a particular port number.
      * You can then send this packet (after customizing any of the payload fields you might need) with
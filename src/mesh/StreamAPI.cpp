@@ -1,6 +1,7 @@
 #include "StreamAPI.h"
 #include "PowerFSM.h"
 #include "configuration.h"
+#include <assert.h>
 
 #define START1 0x94
 #define START2 0xc3
@@ -82,10 +83,42 @@ void StreamAPI::writeStream()
     if (canWrite) {
         uint32_t len;
         do {
-            // Send every packet we can
-            len = getFromRadio(txBuf + HEADER_LEN);
-            emitTxBuffer(len);
+            // Make sure there is room for a max sized frame after what we have batched so far
+            if (txLen + MAX_STREAM_BUF_SIZE > sizeof(txBuf))
+                writeTxBuffer();
+
+            // Send every packet we can, encoding straight into the batch
+            len = getFromRadio(txBuf + txLen + HEADER_LEN);
+            appendFrame(len);
         } while (len);
+
+        // One flush per drain, not per packet
+        if (txLen) {
+            writeTxBuffer();
+            stream->flush();
+        }
+    }
+}
+
+void StreamAPI::appendFrame(size_t len)
+{
+    if (len != 0) {
+        // LOG_DEBUG("emit tx %d\n", len);
+        uint8_t *frame = txBuf + txLen;
+        frame[0] = START1;
+        frame[1] = START2;
+        frame[2] = (len >> 8) & 0xff;
+        frame[3] = len & 0xff;
+
+        txLen += len + HEADER_LEN;
+    }
+}
+
+void StreamAPI::writeTxBuffer()
+{
+    if (txLen) {
+        stream->write(txBuf, txLen);
+        txLen = 0;
     }
 }
 
@@ -95,14 +128,9 @@ void StreamAPI::writeStream()
 void StreamAPI::emitTxBuffer(size_t len)
 {
     if (len != 0) {
-        // LOG_DEBUG("emit tx %d\n", len);
-        txBuf[0] = START1;
-        txBuf[1] = START2;
-        txBuf[2] = (len >> 8) & 0xff;
-        txBuf[3] = len & 0xff;
-
-        auto totalLen = len + HEADER_LEN;
-        stream->write(txBuf, totalLen);
+        assert(txLen == 0); // Only used outside of writeStream, which never leaves frames pending
+        appendFrame(len);
+        writeTxBuffer();
         stream->flush();
     }
 }
@@ -7,6 +7,12 @@
 // A To/FromRadio packet + our 32 bit header
 #define MAX_STREAM_BUF_SIZE (MAX_TO_FROM_RADIO_SIZE + sizeof(uint32_t))
 
+// Outgoing frames are batched in a buffer this big, so a drain (i.e. a config download) becomes a few large writes rather than
+// one write + flush per FromRadio.  Must hold at least one max sized frame.
+#ifndef STREAM_TX_BUF_SIZE
+#define STREAM_TX_BUF_SIZE (2 * MAX_STREAM_BUF_SIZE)
+#endif
+
 /**
  * A version of our 'phone' API that talks over a Stream.  So therefore well suited to use with serial links
  * or TCP connections.
@@ -61,6 +67,12 @@ class StreamAPI : public PhoneAPI
      */
     void writeStream();
 
+    /// Frame the len byte FromRadio already encoded at txBuf + txLen + HEADER_LEN and add it to the pending output
+    void appendFrame(size_t len);
+
+    /// Write any pending frames to the stream (without flushing it)
+    void writeTxBuffer();
+
   protected:
     /**
      * Send a FromRadio.rebooted = true packet to the phone
@@ -73,13 +85,16 @@ class StreamAPI : public PhoneAPI
     virtual bool checkIsConnected() override = 0;
 
     /**
-     * Send the current txBuffer over our stream
+     * Send the len byte FromRadio encoded at txBuf + HEADER_LEN over our stream right away
      */
     void emitTxBuffer(size_t len);
 
     /// Are we allowed to write packets to our output stream (subclasses can turn this off - i.e. SerialConsole)
     bool canWrite = true;
 
-    /// Subclasses can use this scratch buffer if they wish
-    uint8_t txBuf[MAX_STREAM_BUF_SIZE] = {0};
+    /// Frames waiting to be written, subclasses can use this as a scratch buffer when nothing is pending
+    uint8_t txBuf[STREAM_TX_BUF_SIZE] = {0};
+
+    /// Bytes of txBuf holding complete frames which have not been written yet
+    size_t txLen = 0;
 };
@@ -0,0 +1,236 @@
+#include "configuration.h"
+#include "ToPhoneQueue.h"
+#include "FSCommon.h"
+#include "concurrency/LockGuard.h"
+#include <ErriezCRC32.h>
+
+static const char *logFileName = "/prefs/tophone.log";
+
+/// One whole record (header plus encoded packet), only used from the main loop
+static uint8_t recordBuf[sizeof(ToPhoneLogRecord) + MeshPacket_size];
+
+/// Build a record for the packet p (or a delivery marker if p is NULL) in recordBuf, returns its length
+static size_t buildRecord(uint8_t type, uint32_t seq, const MeshPacket *p)
+{
+    ToPhoneLogRecord *h = (ToPhoneLogRecord *)recordBuf;
+    memset(h, 0, sizeof(*h));
+    h->type = type;
+    h->seq = seq;
+    if (p)
+        h->len = pb_encode_to_bytes(recordBuf + sizeof(*h), MeshPacket_size, &MeshPacket_msg, p);
+
+    size_t n = sizeof(*h) + h->len;
+    h->crc = crc32Buffer(recordBuf, n);
+    return n;
+}
+
+/// Append the record last built in recordBuf to f
+template <class F> static bool writeRecord(F &f, size_t n)
+{
+    return f.write(recordBuf, n) == n;
+}
+
+size_t ToPhoneQueue::buildPacketRecord(uint32_t seq)
+{
+    concurrency::LockGuard g(&lock);
+
+    if ((int32_t)(seq - headSeq()) < 0 || (int32_t)(nextSeq - seq) <= 0)
+        return 0; // Collected (or dropped) since the caller looked
+    return buildRecord(TOPHONE_LOG_PACKET, seq, slots[(head + (seq - headSeq())) % MAX_RX_TOPHONE]);
+}
+
+void ToPhoneQueue::getRange(uint32_t &first, uint32_t &end)
+{
+    concurrency::LockGuard g(&lock);
+    first = headSeq();
+    end = nextSeq;
+}
+
+void ToPhoneQueue::dropOldest()
+{
+    LOG_WARN("ToPhone queue is full, discarding oldest\n");
+    packetPool.release(slots[head]);
+    head = (head + 1) % MAX_RX_TOPHONE;
+    count--;
+    numDropped++;
+}
+
+void ToPhoneQueue::enqueue(MeshPacket *p)
+{
+    concurrency::LockGuard g(&lock);
+
+    if (count == MAX_RX_TOPHONE)
+        dropOldest();
+
+    slots[(head + count) % MAX_RX_TOPHONE] = p;
+    count++;
+    nextSeq++;
+}
+
+MeshPacket *ToPhoneQueue::dequeue()
+{
+    concurrency::LockGuard g(&lock);
+
+    phoneSeen = true;
+
+    if (!count)
+        return NULL;
+
+    MeshPacket *p = slots[head];
+    head = (head + 1) % MAX_RX_TOPHONE;
+    count--;
+    return p;
+}
+
+void ToPhoneQueue::load()
+{
+#ifdef FSCom
+    auto f = FSCom.open(logFileName, FILE_O_READ);
+    if (!f)
+        return;
+
+    ToPhoneLogRecord *h = (ToPhoneLogRecord *)recordBuf;
+    while (f.read(recordBuf, sizeof(*h)) == sizeof(*h)) {
+        if (h->len > MeshPacket_size || f.read(recordBuf + sizeof(*h), h->len) != h->len)
+            break;
+
+        uint32_t crc = h->crc;
+        h->crc = 0;
+        if (crc32Buffer(recordBuf, sizeof(*h) + h->len) != crc) {
+            LOG_WARN("Ignoring the torn end of %s\n", logFileName);
+            break;
+        }
+
+        if (h->type == TOPHONE_LOG_PACKET && h->len) {
+            MeshPacket *p = packetPool.allocZeroed();
+            if (!pb_decode_from_bytes(recordBuf + sizeof(*h), h->len, &MeshPacket_msg, p)) {
+                packetPool.release(p);
+                continue;
+            }
+
+            concurrency::LockGuard g(&lock);
+            if (!count)
+                nextSeq = h->seq; // Pick up the log's numbering
+            if (count == MAX_RX_TOPHONE)
+                dropOldest();
+            slots[(head + count) % MAX_RX_TOPHONE] = p;
+            count++;
+            nextSeq++;
+        } else if (h->type == TOPHONE_LOG_DELIVERED) {
+            // Forget everything the phone collected before the marker was written
+            concurrency::LockGuard g(&lock);
+            while (count && (int32_t)(h->seq - headSeq()) > 0) {
+                packetPool.release(slots[head]);
+                head = (head + 1) % MAX_RX_TOPHONE;
+                count--;
+            }
+        }
+    }
+    f.close();
+
+    LOG_INFO("Restored %d packets for the phone from flash\n", count);
+    rewrite();
+#endif
+}
+
+void ToPhoneQueue::flush(bool force)
+{
+#ifdef FSCom
+    // With nobody collecting, the queue just churns: don't wear the flash for that until we are about to reboot or sleep
+    if (!force && (!phoneSeen || millis() - lastFlushMsec < TOPHONE_LOG_FLUSH_MSEC))
+        return;
+    lastFlushMsec = millis();
+
+    // Only the encoding happens under the lock, so the BLE task never waits on the filesystem
+    uint32_t first, end;
+    getRange(first, end);
+    if (persistedSeq == end && persistedDeliveredSeq == first)
+        return; // Nothing changed
+
+    // The usual case while a phone is connected: everything was collected, so we don't need a log at all
+    if (first == end || logSize > TOPHONE_LOG_MAX_SIZE) {
+        rewrite();
+        return;
+    }
+
+    FSCom.mkdir("/prefs");
+    auto f = FSCom.open(logFileName, FILE_O_APPEND);
+    if (!f) {
+        LOG_ERROR("Can't append to %s\n", logFileName);
+        return;
+    }
+
+    // The delivery marker goes first, so load() forgets the collected packets before it queues the new ones
+    bool okay = true;
+    if (persistedDeliveredSeq != first)
+        okay = writeRecord(f, buildRecord(TOPHONE_LOG_DELIVERED, first, NULL));
+
+    // Only packets which are still queued, the phone already has any we never got around to writing
+    uint32_t seq = ((int32_t)(first - persistedSeq) > 0) ? first : persistedSeq;
+    for (; okay && seq != end; seq++) {
+        size_t n = buildPacketRecord(seq);
+        if (n)
+            okay = writeRecord(f, n);
+    }
+
+    logSize = f.size();
+    f.close();
+
+    if (okay) {
+        persistedSeq = end;
+        persistedDeliveredSeq = first;
+    } else {
+        LOG_ERROR("Can't write %s\n", logFileName);
+    }
+#endif
+}
+
+void ToPhoneQueue::rewrite()
+{
+#ifdef FSCom
+    uint32_t first, end;
+    getRange(first, end);
+    if (first == end) {
+        if (FSCom.exists(logFileName) && !FSCom.remove(logFileName))
+            LOG_WARN("Can't remove %s\n", logFileName);
+        logSize = 0;
+    } else {
+        // Write the new log beside the old one, so failing part way through loses nothing
+        String filenameTmp = logFileName;
+        filenameTmp += ".tmp";
+        FSCom.mkdir("/prefs");
+        if (FSCom.exists(filenameTmp.c_str()))
+            FSCom.remove(filenameTmp.c_str());
+        auto f = FSCom.open(filenameTmp.c_str(), FILE_O_WRITE);
+        if (!f) {
+            LOG_ERROR("Can't write %s\n", filenameTmp.c_str());
+            return;
+        }
+
+        bool okay = true;
+        for (uint32_t seq = first; okay && seq != end; seq++) {
+            size_t n = buildPacketRecord(seq);
+            if (n)
+                okay = writeRecord(f, n);
+        }
+        size_t newSize = f.size();
+        f.close();
+        if (!okay) {
+            LOG_ERROR("Can't write %s\n", filenameTmp.c_str());
+            return;
+        }
+
+        // brief window of risk here, as with the prefs files
+        if (FSCom.exists(logFileName) && !FSCom.remove(logFileName))
+            LOG_WARN("Can't remove %s\n", logFileName);
+        if (!renameFile(filenameTmp.c_str(), logFileName)) {
+            LOG_ERROR("Can't rename %s\n", filenameTmp.c_str());
+            return;
+        }
+        logSize = newSize;
+    }
+
+    persistedSeq = end;
+    persistedDeliveredSeq = first;
+#endif
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include "concurrency/Lock.h"
+#include "mesh-pb-constants.h"
+
+/// How often we copy packets the phone hasn't picked up yet to flash (the most we can lose if we crash), once a phone has
+/// connected since boot
+#define TOPHONE_LOG_FLUSH_MSEC (10 * 1000)
+
+/// Once the log grows past this we rewrite it with just the undelivered packets
+#define TOPHONE_LOG_MAX_SIZE (8 * 1024)
+
+/**
+ * Header of each record in the to-phone log, followed by len bytes of payload.
+ */
+struct ToPhoneLogRecord {
+    uint8_t type;  // TOPHONE_LOG_PACKET or TOPHONE_LOG_DELIVERED
+    uint8_t reserved;
+    uint16_t len;  // for a packet the size of the encoded MeshPacket which follows, otherwise 0
+    uint32_t seq;  // for a packet its sequence number, for a delivery marker the first seq not yet delivered
+    uint32_t crc;  // crc32 of the header (with crc = 0) and payload, a torn record at the end of the log fails this
+};
+
+#define TOPHONE_LOG_PACKET 1
+#define TOPHONE_LOG_DELIVERED 2
+
+/**
+ * The bounded queue of received packets waiting for the phone.
+ *
+ * When full the oldest packet is dropped, and counted so clients can be told about it.  Packets which sit here for a while
+ * (because no phone is connected) are mirrored to an append-only log in flash, so they survive a reboot or deep sleep and are
+ * queued again by load().  Packets a phone collects promptly never touch flash, and a node no phone has used since boot
+ * only writes the log just before it reboots or sleeps.
+ *
+ * enqueue() and dequeue() may be called from other tasks (e.g. the BLE stack), flush() and load() only from the main loop.
+ * The lock only covers the queue itself, never filesystem access.
+ */
+class ToPhoneQueue
+{
+    MeshPacket *slots[MAX_RX_TOPHONE] = {};
+    uint8_t head = 0, count = 0;
+
+    /// The sequence number of the next packet we enqueue, the oldest queued packet is nextSeq - count
+    uint32_t nextSeq = 0;
+
+    /// Every packet before this is in the log
+    uint32_t persistedSeq = 0;
+
+    /// The last delivery marker in the log
+    uint32_t persistedDeliveredSeq = 0;
+
+    /// Bytes in the log file
+    size_t logSize = 0;
+
+    uint32_t lastFlushMsec = 0;
+
+    /// Set once any client has read from us since boot
+    bool phoneSeen = false;
+
+    uint32_t numDropped = 0;
+
+    concurrency::Lock lock;
+
+  public:
+    /// Queue p (which must be from packetPool), discarding the oldest packet if we are full
+    void enqueue(MeshPacket *p);
+
+    /// The oldest packet or NULL, the caller must release it to packetPool
+    MeshPacket *dequeue();
+
+    bool isEmpty() { return count == 0; }
+
+    /// How many packets were discarded because the phone didn't collect them in time, since boot
+    uint32_t getNumDropped() { return numDropped; }
+
+    /// Queue the packets left in the log by our last boot
+    void load();
+
+    /**
+     * Bring the log up to date with the queue.  Cheap if nothing changed, and unless force is set only does real work every
+     * TOPHONE_LOG_FLUSH_MSEC, and only after a phone has been seen.
+     */
+    void flush(bool force = false);
+
+  private:
+    /// The sequence number of the oldest packet still queued
+    uint32_t headSeq() const { return nextSeq - count; }
+
+    /// Drop the oldest packet, caller must hold the lock
+    void dropOldest();
+
+    /// The oldest queued sequence number and one past the newest, as of now
+    void getRange(uint32_t &first, uint32_t &end);
+
+    /// Encode the log record for packet seq, returns 0 if it is no longer queued
+    size_t buildPacketRecord(uint32_t seq);
+
+    /// Replace the log with one holding just the packets still queued
+    void rewrite();
+};
@@ -38,7 +38,9 @@ template <class T> class TypedQueue
             reader->setInterval(0);
             concurrency::mainDelay.interrupt();
         }
-        return xQueueSendToBack(h, &x, maxWait) == pdTRUE;
+        bool okay = xQueueSendToBack(h, &x, maxWait) == pdTRUE;
+        noteEnqueue(okay, uxQueueMessagesWaiting(h));
+        return okay;
     }
 
     bool enqueueFromISR(T x, BaseType_t *higherPriWoken)
@@ -47,7 +49,9 @@ template <class T> class TypedQueue
             reader->setInterval(0);
             concurrency::mainDelay.interruptFromISR(higherPriWoken);
         }
-        return xQueueSendToBackFromISR(h, &x, higherPriWoken) == pdTRUE;
+        bool okay = xQueueSendToBackFromISR(h, &x, higherPriWoken) == pdTRUE;
+        noteEnqueue(okay, uxQueueMessagesWaitingFromISR(h));
+        return okay;
     }
 
     bool dequeue(T *p, TickType_t maxWait = portMAX_DELAY) { return xQueueReceive(h, p, maxWait) == pdTRUE; }
@@ -61,53 +65,108 @@ template <class T> class TypedQueue
      * Note: thread will not be automatically enabled, just have its interval set to 0
      */
     void setReader(concurrency::OSThread *t) { reader = t; }
+
+    /// The most elements we have ever held at once
+    int getHighWater() { return highWater; }
+
+    /// How many enqueues failed because we were full
+    uint32_t getNumFull() { return numFull; }
+
+  private:
+    int highWater = 0;
+    uint32_t numFull = 0;
+
+    void noteEnqueue(bool okay, int waiting)
+    {
+        if (!okay)
+            numFull++;
+        else if (waiting > highWater)
+            highWater = waiting;
+    }
 };
 
 #else
 
-#include <queue>
+#include "concurrency/LockGuard.h"
 
 /**
- * A wrapper for freertos queues.  Note: each element object should be small
- * and POD (Plain Old Data type) as elements are memcpied by value.
+ * A fixed size queue for platforms without FreeRTOS, which like the FreeRTOS one fails to enqueue when it is full.  Note: each
+ * element object should be small and POD (Plain Old Data type) as elements are copied by value.
+ *
+ * These builds run everything from the one main loop, so nothing could fill or empty the queue while we waited: enqueue and
+ * dequeue never block, and maxWait is accepted only to match the FreeRTOS API.
  */
 template <class T> class TypedQueue
 {
-    std::queue<T> q;
+    static_assert(std::is_pod<T>::value, "T must be pod");
+
+    T *buf;
+    int maxElements;
+    int head = 0, count = 0;
+
+    int highWater = 0;
+    uint32_t numFull = 0;
+
+    concurrency::Lock lock;
     concurrency::OSThread *reader = NULL;
 
   public:
-    TypedQueue(int maxElements) {}
+    explicit TypedQueue(int _maxElements) : buf(new T[_maxElements]), maxElements(_maxElements) {}
 
-    int numFree() { return 1; } // Always claim 1 free, because we can grow to any size
+    ~TypedQueue() { delete[] buf; }
 
-    bool isEmpty() { return q.empty(); }
+    int numFree()
+    {
+        concurrency::LockGuard g(&lock);
+        return maxElements - count;
+    }
+
+    bool isEmpty()
+    {
+        concurrency::LockGuard g(&lock);
+        return count == 0;
+    }
 
-    bool enqueue(T x, TickType_t maxWait = portMAX_DELAY)
+    /// Never waits, see above
+    bool enqueue(T x, TickType_t maxWait = 0)
     {
+        {
+            concurrency::LockGuard g(&lock);
+            if (count == maxElements) {
+                numFull++;
+                return false;
+            }
+
+            buf[(head + count) % maxElements] = x;
+            if (++count > highWater)
+                highWater = count;
+        }
+
         if (reader) {
             reader->setInterval(0);
             concurrency::mainDelay.interrupt();
         }
-
-        q.push(x);
         return true;
     }
 
-    // bool enqueueFromISR(T x, BaseType_t *higherPriWoken) { return xQueueSendToBackFromISR(h, &x, higherPriWoken) == pdTRUE; }
-
-    bool dequeue(T *p, TickType_t maxWait = portMAX_DELAY)
+    /// Never waits, see above
+    bool dequeue(T *p, TickType_t maxWait = 0)
     {
-        if (isEmpty())
+        concurrency::LockGuard g(&lock);
+        if (!count)
             return false;
-        else {
-            *p = q.front();
-            q.pop();
-            return true;
-        }
+
+        *p = buf[head];
+        head = (head + 1) % maxElements;
+        count--;
+        return true;
     }
 
-    // bool dequeueFromISR(T *p, BaseType_t *higherPriWoken) { return xQueueReceiveFromISR(h, p, higherPriWoken); }
+    /// The most elements we have ever held at once
+    int getHighWater() { return highWater; }
+
+    /// How many enqueues failed because we were full
+    uint32_t getNumFull() { return numFull; }
 
     void setReader(concurrency::OSThread *t) { reader = t; }
 };
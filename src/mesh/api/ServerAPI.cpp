@@ -1,17 +1,24 @@
 #include "ServerAPI.h"
+#include "MeshService.h"
 #include "configuration.h"
 #include <Arduino.h>
 
 template<typename T>
-ServerAPI<T>::ServerAPI(T &_client) : StreamAPI(&client), concurrency::OSThread("ServerAPI"), client(_client)
+ServerAPI<T>::ServerAPI(T &_client)
+    : StreamAPI(&client), concurrency::OSThread("ServerAPI"), client(_client), packetQueue(MAX_API_CLIENT_QUEUE)
 {
     LOG_INFO("Incoming wifi connection\n");
+    packetObserver.observe(&service.packetForPhone);
 }
 
 template<typename T>
 ServerAPI<T>::~ServerAPI()
 {
     client.stop();
+
+    MeshPacket *p;
+    while ((p = packetQueue.dequeuePtr(0)) != NULL)
+        packetPool.release(p);
 }
 
 template<typename T>
@@ -21,6 +28,30 @@ void ServerAPI<T>::close()
     StreamAPI::close();
 }
 
+template<typename T>
+void ServerAPI<T>::enqueuePacket(MeshPacket *p)
+{
+    if (packetQueue.numFree() == 0) {
+        LOG_WARN("API client is not keeping up, discarding oldest packet\n");
+        MeshPacket *d = packetQueue.dequeuePtr(0);
+        if (d)
+            packetPool.release(d);
+        numDropped++;
+    }
+    packetQueue.enqueue(p, 0);
+
+    setIntervalFromNow(0); // Don't wait for our next poll to pass it on
+}
+
+template<typename T>
+int ServerAPI<T>::onPacketForPhone(const MeshPacket *p)
+{
+    // Until the client asks for config it isn't using the protobuf API at all
+    if (isConnected())
+        enqueuePacket(packetPool.allocCopy(*p));
+    return 0;
+}
+
 /// Check the current underlying physical link to see if the client is currently connected
 template<typename T>
 bool ServerAPI<T>::checkIsConnected()
@@ -35,7 +66,7 @@ int32_t ServerAPI<T>::runOnce()
         return StreamAPI::runOncePart();
     } else {
         LOG_INFO("Client dropped connection, suspending API service\n");
-        enabled = false; // we no longer need to run
+        enabled = false; // we no longer need to run, APIServerPort will delete us
         return 0;
     }
 }
@@ -52,15 +83,29 @@ void APIServerPort<T, U>::init()
 template<class T, class U>
 int32_t APIServerPort<T, U>::runOnce()
 {
+    // Free the sessions of clients which have gone away
+    for (int i = 0; i < MAX_API_CLIENTS; i++) {
+        if (openAPIs[i] && !openAPIs[i]->isOpen()) {
+            LOG_INFO("Closing API connection %d\n", i);
+            delete openAPIs[i];
+            openAPIs[i] = NULL;
+        }
+    }
+
     auto client = U::available();
     if (client) {
-        // Close any previous connection (see FIXME in header file)
-        if (openAPI) {
-            LOG_INFO("Force closing previous TCP connection\n");
-            delete openAPI;
-        }
+        int slot = -1;
+        for (int i = 0; i < MAX_API_CLIENTS && slot < 0; i++)
+            if (!openAPIs[i])
+                slot = i;
 
-        openAPI = new T(client);
+        if (slot < 0) {
+            LOG_WARN("Already have %d API connections, refusing another\n", MAX_API_CLIENTS);
+            client.stop();
+        } else {
+            LOG_INFO("Opening API connection %d\n", slot);
+            openAPIs[slot] = new T(client);
+        }
     }
 
     return 100; // only check occasionally for incoming connections
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "PointerQueue.h"
 #include "StreamAPI.h"
 
+/// How many API clients (apps, loggers, dashboards...) can be connected over TCP at once
+#ifndef MAX_API_CLIENTS
+#define MAX_API_CLIENTS 4
+#endif
+
+/// Mesh packets we hold for each client, if a client can't keep up the oldest are dropped
+#define MAX_API_CLIENT_QUEUE 32
+
 /**
  * Provides both debug printing and, if the client starts sending protobufs to us, switches to send/receive protobufs
  * (and starts dropping debug printing - FIXME, eventually those prints should be encapsulated in protobufs).
+ *
+ * Each connection has its own PhoneAPI state and its own queue of mesh packets.  Those are copies of what MeshService queues
+ * for the phone, so TCP clients never take packets away from a BLE or serial phone (or from each other).
  */
 template<class T>
 class ServerAPI : public StreamAPI, private concurrency::OSThread
@@ -12,6 +24,15 @@ class ServerAPI : public StreamAPI, private concurrency::OSThread
   private:
     T client;
 
+    /// Packets waiting for this client (copies, we own them)
+    PointerQueue<MeshPacket> packetQueue;
+
+    CallbackObserver<ServerAPI<T>, const MeshPacket *> packetObserver =
+        CallbackObserver<ServerAPI<T>, const MeshPacket *>(this, &ServerAPI<T>::onPacketForPhone);
+
+    /// Called for every packet MeshService queues for the phone
+    int onPacketForPhone(const MeshPacket *p);
+
   public:
     explicit ServerAPI(T &_client);
 
@@ -20,6 +41,12 @@ class ServerAPI : public StreamAPI, private concurrency::OSThread
     /// override close to also shutdown the TCP link
     virtual void close();
 
+    /// Is the TCP connection still up?
+    bool isOpen() { return client.connected(); }
+
+    /// Give this client a packet to deliver, we take ownership of p
+    void enqueuePacket(MeshPacket *p);
+
   protected:
     /// We override this method to prevent publishing EVENT_SERIAL_CONNECTED/DISCONNECTED for wifi links (we want the board to
     /// stay in the POWERED state to prevent disabling wifi)
@@ -29,6 +56,12 @@ class ServerAPI : public StreamAPI, private concurrency::OSThread
 
     /// Check the current underlying physical link to see if the client is currently connected
     virtual bool checkIsConnected() override;
+
+    /// We read from our own queue rather than the shared MeshService one, so every client sees every packet
+    virtual MeshPacket *getNextPacketForPhone() override { return packetQueue.dequeuePtr(0); }
+
+    /// We never read the shared queue, so its drops aren't ours
+    virtual uint32_t getNumDroppedForPhone() override { return numDropped; }
 };
 
 /**
@@ -37,12 +70,8 @@ class ServerAPI : public StreamAPI, private concurrency::OSThread
 template<class T, class U>
 class APIServerPort : public U, private concurrency::OSThread
 {
-    /** The currently open port
-     *
-     * FIXME: We currently only allow one open TCP connection at a time, because we depend on the loop() call in this class to
-     * delegate to the worker.  Once coroutines are implemented we can relax this restriction.
-     */
-    T *openAPI = NULL;
+    /// The currently open connections, each runs as its own thread
+    T *openAPIs[MAX_API_CLIENTS] = {};
 
   public:
     explicit APIServerPort(int port);
@@ -4,6 +4,7 @@
 #include "airtime.h"
 #include "main.h"
 #include "mesh/http/ContentHelper.h"
+#include "mesh/http/StaticFileCache.h"
 #include "mesh/http/WebServer.h"
 #include "mesh/http/WiFiAPClient.h"
 #include "power.h"
@@ -12,7 +13,7 @@
 #include <HTTPBodyParser.hpp>
 #include <HTTPMultipartBodyParser.hpp>
 #include <HTTPURLEncodedBodyParser.hpp>
-#include "mqtt/JSON.h"
+#include "mqtt/JSONWriter.h"
 
 #ifdef ARCH_ESP32
 #include "esp_task_wdt.h"
@@ -63,7 +64,12 @@ char contentTypes[][2][32] = {{".txt", "text/plain"},     {".html", "text/html"}
 // Our API to handle messages to and from the radio.
 HttpAPI webAPI;
 
-void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
+// FromRadio replies are packed back to back in here, so a response goes out in a few large writes instead of one per
+// protobuf (each write is an SSL record on the secure server).  Handlers run one at a time, so one buffer is enough.
+#define FROMRADIO_BATCH_SIZE (4 * MAX_TO_FROM_RADIO_SIZE)
+static uint8_t fromRadioBatch[FROMRADIO_BATCH_SIZE];
+
+void registerHandlers(HTTPServer *server)
 {
 
     // For every resource available on the server, we need to create a ResourceNode
@@ -94,47 +100,25 @@ void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
 
     ResourceNode *nodeRoot = new ResourceNode("/*", "GET", &handleStatic);
 
-    // Secure nodes
-    secureServer->registerNode(nodeAPIv1ToRadioOptions);
-    secureServer->registerNode(nodeAPIv1ToRadio);
-    secureServer->registerNode(nodeAPIv1FromRadio);
-    //    secureServer->registerNode(nodeHotspotApple);
-    //    secureServer->registerNode(nodeHotspotAndroid);
-    secureServer->registerNode(nodeRestart);
-    secureServer->registerNode(nodeFormUpload);
-    secureServer->registerNode(nodeJsonScanNetworks);
-    secureServer->registerNode(nodeJsonBlinkLED);
-    secureServer->registerNode(nodeJsonFsBrowseStatic);
-    secureServer->registerNode(nodeJsonDelete);
-    secureServer->registerNode(nodeJsonReport);
-    //    secureServer->registerNode(nodeUpdateFs);
-    //    secureServer->registerNode(nodeDeleteFs);
-    secureServer->registerNode(nodeAdmin);
-    //    secureServer->registerNode(nodeAdminFs);
-    //    secureServer->registerNode(nodeAdminSettings);
-    //    secureServer->registerNode(nodeAdminSettingsApply);
-    secureServer->registerNode(nodeRoot); // This has to be last
-
-    // Insecure nodes
-    insecureServer->registerNode(nodeAPIv1ToRadioOptions);
-    insecureServer->registerNode(nodeAPIv1ToRadio);
-    insecureServer->registerNode(nodeAPIv1FromRadio);
-    //    insecureServer->registerNode(nodeHotspotApple);
-    //    insecureServer->registerNode(nodeHotspotAndroid);
-    insecureServer->registerNode(nodeRestart);
-    insecureServer->registerNode(nodeFormUpload);
-    insecureServer->registerNode(nodeJsonScanNetworks);
-    insecureServer->registerNode(nodeJsonBlinkLED);
-    insecureServer->registerNode(nodeJsonFsBrowseStatic);
-    insecureServer->registerNode(nodeJsonDelete);
-    insecureServer->registerNode(nodeJsonReport);
-    //    insecureServer->registerNode(nodeUpdateFs);
-    //    insecureServer->registerNode(nodeDeleteFs);
-    insecureServer->registerNode(nodeAdmin);
-    //    insecureServer->registerNode(nodeAdminFs);
-    //    insecureServer->registerNode(nodeAdminSettings);
-    //    insecureServer->registerNode(nodeAdminSettingsApply);
-    insecureServer->registerNode(nodeRoot); // This has to be last
+    server->registerNode(nodeAPIv1ToRadioOptions);
+    server->registerNode(nodeAPIv1ToRadio);
+    server->registerNode(nodeAPIv1FromRadio);
+    //    server->registerNode(nodeHotspotApple);
+    //    server->registerNode(nodeHotspotAndroid);
+    server->registerNode(nodeRestart);
+    server->registerNode(nodeFormUpload);
+    server->registerNode(nodeJsonScanNetworks);
+    server->registerNode(nodeJsonBlinkLED);
+    server->registerNode(nodeJsonFsBrowseStatic);
+    server->registerNode(nodeJsonDelete);
+    server->registerNode(nodeJsonReport);
+    //    server->registerNode(nodeUpdateFs);
+    //    server->registerNode(nodeDeleteFs);
+    server->registerNode(nodeAdmin);
+    //    server->registerNode(nodeAdminFs);
+    //    server->registerNode(nodeAdminSettings);
+    //    server->registerNode(nodeAdminSettingsApply);
+    server->registerNode(nodeRoot); // This has to be last
 }
 
 void handleAPIv1FromRadio(HTTPRequest *req, HTTPResponse *res)
@@ -160,32 +144,27 @@ void handleAPIv1FromRadio(HTTPRequest *req, HTTPResponse *res)
     res->setHeader("Access-Control-Allow-Methods", "GET");
     res->setHeader("X-Protobuf-Schema", "https://raw.githubusercontent.com/meshtastic/protobufs/master/mesh.proto");
 
-    uint8_t txBuf[MAX_STREAM_BUF_SIZE];
-    uint32_t len = 1;
-
-    if (params->getQueryParameter("all", valueAll)) {
-
-        // If all is ture, return all the buffers we have available
-        //   to us at this point in time.
-        if (valueAll == "true") {
-            while (len) {
-                len = webAPI.getFromRadio(txBuf);
-                res->write(txBuf, len);
-            }
-
-            // Otherwise, just return one protobuf
-        } else {
-            len = webAPI.getFromRadio(txBuf);
-            res->write(txBuf, len);
+    // If all is true, return all the buffers we have available to us at this point in time.  Otherwise (or if the param
+    // "all" was not specified) return just one protobuf
+    bool all = params->getQueryParameter("all", valueAll) && valueAll == "true";
+
+    size_t batchLen = 0, total = 0;
+    size_t len;
+    do {
+        // Send what we have if the next protobuf might not fit
+        if (batchLen + MAX_TO_FROM_RADIO_SIZE > sizeof(fromRadioBatch)) {
+            res->write(fromRadioBatch, batchLen);
+            batchLen = 0;
         }
+        len = webAPI.getFromRadio(fromRadioBatch + batchLen);
+        batchLen += len;
+        total += len;
+    } while (all && len);
 
-        // the param "all" was not spcified. Return just one protobuf
-    } else {
-        len = webAPI.getFromRadio(txBuf);
-        res->write(txBuf, len);
-    }
+    if (batchLen)
+        res->write(fromRadioBatch, batchLen);
 
-    LOG_DEBUG("webAPI handleAPIv1FromRadio, len %d\n", len);
+    LOG_DEBUG("webAPI handleAPIv1FromRadio, len %d\n", total);
 }
 
 void handleAPIv1ToRadio(HTTPRequest *req, HTTPResponse *res)
@@ -246,15 +225,18 @@ void htmlDeleteDir(const char *dirname)
     root.close();
 }
 
-JSONArray htmlListDir(const char *dirname, uint8_t levels)
+void htmlListDir(JSONWriter &w, const char *dirname, uint8_t levels)
 {
+    w.beginArray();
     File root = FSCom.open(dirname, FILE_O_READ);
-    JSONArray fileList;
     if (!root) {
-        return fileList;
+        w.endArray();
+        return;
     }
     if (!root.isDirectory()) {
-        return fileList;
+        root.close();
+        w.endArray();
+        return;
     }
 
     // iterate over the file list
@@ -263,36 +245,33 @@ JSONArray htmlListDir(const char *dirname, uint8_t levels)
         if (file.isDirectory() && !String(file.name()).endsWith(".")) {
             if (levels) {
 #ifdef ARCH_ESP32
-                fileList.push_back(new JSONValue(htmlListDir(file.path(), levels - 1)));
+                htmlListDir(w, file.path(), levels - 1);
 #else
-                fileList.push_back(new JSONValue(htmlListDir(file.name(), levels - 1)));
+                htmlListDir(w, file.name(), levels - 1);
 #endif
                 file.close();
             }
         } else {
-            JSONObject thisFileMap;
-            thisFileMap["size"] = new JSONValue((int)file.size());
+            w.beginObject();
+            w.field("size", (int)file.size());
 #ifdef ARCH_ESP32
-            thisFileMap["name"] = new JSONValue(String(file.path()).substring(1).c_str());
+            String name = String(file.path()).substring(1);
 #else
-            thisFileMap["name"] = new JSONValue(String(file.name()).substring(1).c_str());
+            String name = String(file.name()).substring(1);
 #endif
+            w.field("name", name.c_str());
             if (String(file.name()).substring(1).endsWith(".gz")) {
-#ifdef ARCH_ESP32
-                String modifiedFile = String(file.path()).substring(1);
-#else
-                String modifiedFile = String(file.name()).substring(1);
-#endif
+                String modifiedFile = name;
                 modifiedFile.remove((modifiedFile.length() - 3), 3);
-                thisFileMap["nameModified"] = new JSONValue(modifiedFile.c_str());
+                w.field("nameModified", modifiedFile.c_str());
             }
-            fileList.push_back(new JSONValue(thisFileMap));
+            w.endObject();
         }
         file.close();
         file = root.openNextFile();
     }
     root.close();
-    return fileList;
+    w.endArray();
 }
 
 void handleFsBrowseStatic(HTTPRequest *req, HTTPResponse *res)
@@ -301,27 +280,22 @@ void handleFsBrowseStatic(HTTPRequest *req, HTTPResponse *res)
     res->setHeader("Access-Control-Allow-Origin", "*");
     res->setHeader("Access-Control-Allow-Methods", "GET");
 
-    auto fileList = htmlListDir("/static", 10);
-
-    // create json output structure
-    JSONObject filesystemObj;
-    filesystemObj["total"] = new JSONValue((int)FSCom.totalBytes());
-    filesystemObj["used"] = new JSONValue((int)FSCom.usedBytes());
-    filesystemObj["free"] = new JSONValue(int(FSCom.totalBytes() - FSCom.usedBytes()));
-
-    JSONObject jsonObjInner;
-    jsonObjInner["files"] = new JSONValue(fileList);
-    jsonObjInner["filesystem"] = new JSONValue(filesystemObj);
-
-    JSONObject jsonObjOuter;
-    jsonObjOuter["data"] = new JSONValue(jsonObjInner);
-    jsonObjOuter["status"] = new JSONValue("ok");
-
-    JSONValue *value = new JSONValue(jsonObjOuter);
-
-    res->print(value->Stringify().c_str());
-
-	delete value;
+    // serialize straight to the response as we walk the filesystem
+    JSONWriter w(res);
+    w.beginObject();
+    w.key("data");
+    w.beginObject();
+    w.key("files");
+    htmlListDir(w, "/static", 10);
+    w.key("filesystem");
+    w.beginObject();
+    w.field("total", (int)FSCom.totalBytes());
+    w.field("used", (int)FSCom.usedBytes());
+    w.field("free", int(FSCom.totalBytes() - FSCom.usedBytes()));
+    w.endObject();
+    w.endObject();
+    w.field("status", "ok");
+    w.endObject();
 }
 
 void handleFsDeleteStatic(HTTPRequest *req, HTTPResponse *res)
@@ -334,24 +308,84 @@ void handleFsDeleteStatic(HTTPRequest *req, HTTPResponse *res)
     res->setHeader("Access-Control-Allow-Methods", "DELETE");
     if (params->getQueryParameter("delete", paramValDelete)) {
         std::string pathDelete = "/" + paramValDelete;
+        staticFileCache.clear();
+        JSONWriter w(res);
+        w.beginObject();
         if (FSCom.remove(pathDelete.c_str())) {
             LOG_INFO("%s\n", pathDelete.c_str());
-            JSONObject jsonObjOuter; 
-            jsonObjOuter["status"] = new JSONValue("ok");
-            JSONValue *value = new JSONValue(jsonObjOuter);
-            res->print(value->Stringify().c_str());
-            delete value;
-            return;
+            w.field("status", "ok");
         } else {
             LOG_INFO("%s\n", pathDelete.c_str());
-            JSONObject jsonObjOuter;
-            jsonObjOuter["status"] = new JSONValue("Error");
-            JSONValue *value = new JSONValue(jsonObjOuter);
-            res->print(value->Stringify().c_str());
-            delete value;
-            return;
+            w.field("status", "Error");
+        }
+        w.endObject();
+        return;
+    }
+}
+
+/// True if the file name carries a content hash (as in index-3f9a2c1b.js), so it never changes and can be cached forever
+static bool isHashedAsset(const std::string &filename)
+{
+    // Look at each '-' or '.' separated part of the name (ignoring the extension) for 8-20 letters and digits
+    size_t start = filename.find_last_of('/') + 1;
+    size_t end = filename.rfind('.');
+    if (end == std::string::npos || end < start)
+        return false;
+
+    while (start < end) {
+        size_t next = filename.find_first_of("-.", start);
+        size_t len = next - start;
+        bool digit = false, alnum = len >= 8 && len <= 20;
+        for (size_t i = start; alnum && i < next; i++) {
+            alnum = isalnum((unsigned char)filename[i]);
+            digit |= isdigit((unsigned char)filename[i]);
         }
+        if (alnum && digit)
+            return true;
+        start = next + 1;
     }
+    return false;
+}
+
+/// Write the response headers for a static file, returns false if the browser's copy is current and we have answered 304
+static bool staticHeaders(HTTPRequest *req, HTTPResponse *res, const std::string &filename, bool gzip, const char *etag)
+{
+    res->setHeader("ETag", etag);
+    res->setHeader("Cache-Control", isHashedAsset(filename) ? "public, max-age=31536000, immutable" : "no-cache");
+
+    // The header may list several tags
+    if (req->getHeader("If-None-Match").find(etag) != std::string::npos) {
+        res->setStatusCode(304);
+        res->setStatusText("Not Modified");
+        return false;
+    }
+
+    if (gzip)
+        res->setHeader("Content-Encoding", "gzip");
+
+    // Content-Type is guessed using the definition of the contentTypes-table defined above
+    int cTypeIdx = 0;
+    do {
+        if (filename.rfind(contentTypes[cTypeIdx][0]) != std::string::npos) {
+            res->setHeader("Content-Type", contentTypes[cTypeIdx][1]);
+            return true;
+        }
+        cTypeIdx += 1;
+    } while (strlen(contentTypes[cTypeIdx][0]) > 0);
+
+    // Set a default content type
+    res->setHeader("Content-Type", "application/octet-stream");
+    return true;
+}
+
+// Files are copied to the response in blocks this big, handlers run one at a time so one buffer is enough
+#define STATIC_READ_SIZE 4096
+static uint8_t staticReadBuf[STATIC_READ_SIZE];
+
+static void writeCached(HTTPResponse *res, const StaticFileCache::Entry *cached)
+{
+    for (size_t pos = 0; pos < cached->size; pos += STATIC_READ_SIZE)
+        res->write(cached->data + pos, min((size_t)STATIC_READ_SIZE, cached->size - pos));
 }
 
 void handleStatic(HTTPRequest *req, HTTPResponse *res)
@@ -366,16 +400,25 @@ void handleStatic(HTTPRequest *req, HTTPResponse *res)
         std::string filename = "/static/" + parameter1;
         std::string filenameGzip = "/static/" + parameter1 + ".gz";
 
-        // Try to open the file
-        File file;
-
-        bool has_set_content_type = false;
-
         if (filename == "/static/") {
             filename = "/static/index.html";
             filenameGzip = "/static/index.html.gz";
         }
 
+        // The hot files (the web client itself) come straight from RAM
+        const StaticFileCache::Entry *cached = staticFileCache.find(filename);
+        if (cached) {
+            if (staticHeaders(req, res, filename, cached->gzip, cached->etag)) {
+                res->setHeader("Content-Length", httpsserver::intToString(cached->size));
+                writeCached(res, cached);
+            }
+            return;
+        }
+
+        // Try to open the file
+        File file;
+        bool gzip = false, cacheable = false;
+
         if (FSCom.exists(filename.c_str())) {
             file = FSCom.open(filename.c_str());
             if (!file.available()) {
@@ -383,54 +426,52 @@ void handleStatic(HTTPRequest *req, HTTPResponse *res)
             }
         } else if (FSCom.exists(filenameGzip.c_str())) {
             file = FSCom.open(filenameGzip.c_str());
-            res->setHeader("Content-Encoding", "gzip");
+            gzip = cacheable = true;
             if (!file.available()) {
                 LOG_WARN("File not available - %s\n", filenameGzip.c_str());
             }
         } else {
-            has_set_content_type = true;
             filenameGzip = "/static/index.html.gz";
             file = FSCom.open(filenameGzip.c_str());
-            res->setHeader("Content-Type", "text/html");
             if (!file.available()) {
                 LOG_WARN("File not available - %s\n", filenameGzip.c_str());
+                res->setHeader("Content-Type", "text/html");
                 res->println("Web server is running.<br><br>The content you are looking for can't be found. Please see: <a "
                              "href=https://meshtastic.org/docs/getting-started/faq#wifi--web-browser>FAQ</a>.<br><br><a "
                              "href=/admin>admin</a>");
 
                 return;
-
-            } else {
-                res->setHeader("Content-Encoding", "gzip");
             }
+
+            // Unknown paths get the web client, which does its own routing
+            gzip = true;
+            filename = "/static/index.html";
+        }
+
+        // Files only change through our own handlers, which all bump the modification time, so size and time identify them
+        char etag[24];
+        snprintf(etag, sizeof(etag), "\"%x-%lx\"", (unsigned)file.size(), (unsigned long)file.getLastWrite());
+        if (!staticHeaders(req, res, filename, gzip, etag)) {
+            file.close();
+            return;
         }
 
         res->setHeader("Content-Length", httpsserver::intToString(file.size()));
 
-        // Content-Type is guessed using the definition of the contentTypes-table defined above
-        int cTypeIdx = 0;
-        do {
-            if (filename.rfind(contentTypes[cTypeIdx][0]) != std::string::npos) {
-                res->setHeader("Content-Type", contentTypes[cTypeIdx][1]);
-                has_set_content_type = true;
-                break;
+        // Keep the gzipped files (which is all the web client ships) for next time, but not the fallback for unknown paths
+        if (cacheable) {
+            cached = staticFileCache.add(filename, gzip, etag, file);
+            if (cached) {
+                writeCached(res, cached);
+                file.close();
+                return;
             }
-            cTypeIdx += 1;
-        } while (strlen(contentTypes[cTypeIdx][0]) > 0);
-
-        if (!has_set_content_type) {
-            // Set a default content type
-            res->setHeader("Content-Type", "application/octet-stream");
         }
 
         // Read the file and write it to the HTTP response body
-        size_t length = 0;
-        do {
-            char buffer[256];
-            length = file.read((uint8_t *)buffer, 256);
-            std::string bufferString(buffer, length);
-            res->write((uint8_t *)bufferString.c_str(), bufferString.size());
-        } while (length > 0);
+        size_t length;
+        while ((length = file.read(staticReadBuf, STATIC_READ_SIZE)) > 0)
+            res->write(staticReadBuf, length);
 
         file.close();
 
@@ -521,6 +562,7 @@ void handleFormUpload(HTTPRequest *req, HTTPResponse *res)
         std::string pathname = "/static/" + filename;
 
         // Create a new file to stream the data into
+        staticFileCache.clear();
         File file = FSCom.open(pathname.c_str(), "w");
         size_t fileLength = 0;
         didwrite = true;
@@ -582,88 +624,78 @@ void handleReport(HTTPRequest *req, HTTPResponse *res)
         res->println("<pre>");
     }
 
-    // data->airtime->tx_log
-    JSONArray txLogValues;
-    uint32_t *logArray;
-    logArray = airTime->airtimeReport(TX_LOG);
-    for (int i = 0; i < airTime->getPeriodsToLog(); i++) {
-        txLogValues.push_back(new JSONValue((int)logArray[i]));
-    }
-
-    // data->airtime->rx_log
-    JSONArray rxLogValues;
-    logArray = airTime->airtimeReport(RX_LOG);
-    for (int i = 0; i < airTime->getPeriodsToLog(); i++) {
-        rxLogValues.push_back(new JSONValue((int)logArray[i]));
-    }
-
-    // data->airtime->rx_all_log
-    JSONArray rxAllLogValues;
-    logArray = airTime->airtimeReport(RX_ALL_LOG);
-    for (int i = 0; i < airTime->getPeriodsToLog(); i++) {
-        rxAllLogValues.push_back(new JSONValue((int)logArray[i]));
-    }
+    // serialize straight to the response, field by field
+    JSONWriter w(res);
+    w.beginObject();
+    w.key("data");
+    w.beginObject();
 
     // data->airtime
-    JSONObject jsonObjAirtime;
-    jsonObjAirtime["tx_log"] = new JSONValue(txLogValues);
-    jsonObjAirtime["rx_log"] = new JSONValue(rxLogValues);
-    jsonObjAirtime["rx_all_log"] = new JSONValue(rxAllLogValues);
-    jsonObjAirtime["channel_utilization"] = new JSONValue(airTime->channelUtilizationPercent());
-    jsonObjAirtime["utilization_tx"] = new JSONValue(airTime->utilizationTXPercent());
-    jsonObjAirtime["seconds_since_boot"] = new JSONValue(int(airTime->getSecondsSinceBoot()));
-    jsonObjAirtime["seconds_per_period"] = new JSONValue(int(airTime->getSecondsPerPeriod()));
-    jsonObjAirtime["periods_to_log"] = new JSONValue(airTime->getPeriodsToLog());
+    w.key("airtime");
+    w.beginObject();
+    static const reportTypes logTypes[] = {TX_LOG, RX_LOG, RX_ALL_LOG};
+    static const char *logNames[] = {"tx_log", "rx_log", "rx_all_log"};
+    for (int t = 0; t < 3; t++) {
+        uint32_t *logArray = airTime->airtimeReport(logTypes[t]);
+        w.key(logNames[t]);
+        w.beginArray();
+        for (int i = 0; i < airTime->getPeriodsToLog(); i++) {
+            w.value((int)logArray[i]);
+        }
+        w.endArray();
+    }
+    w.field("channel_utilization", airTime->channelUtilizationPercent());
+    w.field("utilization_tx", airTime->utilizationTXPercent());
+    w.field("seconds_since_boot", int(airTime->getSecondsSinceBoot()));
+    w.field("seconds_per_period", int(airTime->getSecondsPerPeriod()));
+    w.field("periods_to_log", (int)airTime->getPeriodsToLog());
+    w.endObject();
 
     // data->wifi
-    JSONObject jsonObjWifi;
-    jsonObjWifi["rssi"] = new JSONValue(WiFi.RSSI());
-    jsonObjWifi["ip"] = new JSONValue(WiFi.localIP().toString().c_str());
+    w.key("wifi");
+    w.beginObject();
+    w.field("rssi", (int)WiFi.RSSI());
+    w.field("ip", WiFi.localIP().toString().c_str());
+    w.endObject();
 
     // data->memory
-    JSONObject jsonObjMemory;
-    jsonObjMemory["heap_total"] = new JSONValue((int)ESP.getHeapSize());
-    jsonObjMemory["heap_free"] = new JSONValue((int)ESP.getFreeHeap());
-    jsonObjMemory["psram_total"] = new JSONValue((int)ESP.getPsramSize());
-    jsonObjMemory["psram_free"] = new JSONValue((int)ESP.getFreePsram());
-    jsonObjMemory["fs_total"] = new JSONValue((int)FSCom.totalBytes());
-    jsonObjMemory["fs_used"] = new JSONValue((int)FSCom.usedBytes());
-    jsonObjMemory["fs_free"] = new JSONValue(int(FSCom.totalBytes() - FSCom.usedBytes()));
+    w.key("memory");
+    w.beginObject();
+    w.field("heap_total", (int)ESP.getHeapSize());
+    w.field("heap_free", (int)ESP.getFreeHeap());
+    w.field("psram_total", (int)ESP.getPsramSize());
+    w.field("psram_free", (int)ESP.getFreePsram());
+    w.field("fs_total", (int)FSCom.totalBytes());
+    w.field("fs_used", (int)FSCom.usedBytes());
+    w.field("fs_free", int(FSCom.totalBytes() - FSCom.usedBytes()));
+    w.endObject();
 
     // data->power
-    JSONObject jsonObjPower;
-    jsonObjPower["battery_percent"] = new JSONValue(powerStatus->getBatteryChargePercent());
-    jsonObjPower["battery_voltage_mv"] = new JSONValue(powerStatus->getBatteryVoltageMv());
-    jsonObjPower["has_battery"] = new JSONValue(BoolToString(powerStatus->getHasBattery()));
-    jsonObjPower["has_usb"] = new JSONValue(BoolToString(powerStatus->getHasUSB()));
-    jsonObjPower["is_charging"] = new JSONValue(BoolToString(powerStatus->getIsCharging()));
+    w.key("power");
+    w.beginObject();
+    w.field("battery_percent", (int)powerStatus->getBatteryChargePercent());
+    w.field("battery_voltage_mv", (int)powerStatus->getBatteryVoltageMv());
+    w.field("has_battery", BoolToString(powerStatus->getHasBattery()));
+    w.field("has_usb", BoolToString(powerStatus->getHasUSB()));
+    w.field("is_charging", BoolToString(powerStatus->getIsCharging()));
+    w.endObject();
 
     // data->device
-    JSONObject jsonObjDevice;
-    jsonObjDevice["reboot_counter"] = new JSONValue((int)myNodeInfo.reboot_count);
+    w.key("device");
+    w.beginObject();
+    w.field("reboot_counter", (int)myNodeInfo.reboot_count);
+    w.endObject();
 
     // data->radio
-    JSONObject jsonObjRadio;
-    jsonObjRadio["frequency"] = new JSONValue(RadioLibInterface::instance->getFreq());
-    jsonObjRadio["lora_channel"] = new JSONValue((int)RadioLibInterface::instance->getChannelNum());
-
-    // collect data to inner data object
-    JSONObject jsonObjInner;
-    jsonObjInner["airtime"] = new JSONValue(jsonObjAirtime);
-    jsonObjInner["wifi"] = new JSONValue(jsonObjWifi);
-    jsonObjInner["memory"] = new JSONValue(jsonObjMemory);
-    jsonObjInner["power"] = new JSONValue(jsonObjPower);
-    jsonObjInner["device"] = new JSONValue(jsonObjDevice);
-    jsonObjInner["radio"] = new JSONValue(jsonObjRadio);
-
-    // create json output structure
-    JSONObject jsonObjOuter;
-    jsonObjOuter["data"] = new JSONValue(jsonObjInner);
-    jsonObjOuter["status"] = new JSONValue("ok");
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObjOuter);
-    res->print(value->Stringify().c_str());
-    delete value;
+    w.key("radio");
+    w.beginObject();
+    w.field("frequency", RadioLibInterface::instance->getFreq());
+    w.field("lora_channel", (int)RadioLibInterface::instance->getChannelNum());
+    w.endObject();
+
+    w.endObject();
+    w.field("status", "ok");
+    w.endObject();
 }
 
 /*
@@ -700,6 +732,7 @@ void handleDeleteFsContent(HTTPRequest *req, HTTPResponse *res)
     LOG_INFO("Deleting files from /static/* : \n");
 
     htmlDeleteDir("/static");
+    staticFileCache.clear();
 
     res->println("<p><hr><p><a href=/admin>Back to admin</a>\n");
 }
@@ -805,11 +838,10 @@ void handleBlinkLED(HTTPRequest *req, HTTPResponse *res)
 #endif
     }
 
-    JSONObject jsonObjOuter;
-    jsonObjOuter["status"] = new JSONValue("ok");
-    JSONValue *value = new JSONValue(jsonObjOuter);
-    res->print(value->Stringify().c_str());
-    delete value;
+    JSONWriter w(res);
+    w.beginObject();
+    w.field("status", "ok");
+    w.endObject();
 }
 
 void handleScanNetworks(HTTPRequest *req, HTTPResponse *res)
@@ -821,20 +853,18 @@ void handleScanNetworks(HTTPRequest *req, HTTPResponse *res)
 
     int n = WiFi.scanNetworks();
 
-    // build list of network objects
-    JSONArray networkObjs;
+    // write the list of network objects as we go
+    JSONWriter w(res);
+    w.beginObject();
+    w.key("data");
+    w.beginArray();
     if (n > 0) {
         for (int i = 0; i < n; ++i) {
-            char ssidArray[50];
-            String ssidString = String(WiFi.SSID(i));
-            ssidString.replace("\"", "\\\"");
-            ssidString.toCharArray(ssidArray, 50);
-
             if (WiFi.encryptionType(i) != WIFI_AUTH_OPEN) {
-                JSONObject thisNetwork;
-                thisNetwork["ssid"] = new JSONValue(ssidArray);
-                thisNetwork["rssi"] = new JSONValue(WiFi.RSSI(i));
-                networkObjs.push_back(new JSONValue(thisNetwork));
+                w.beginObject();
+                w.field("ssid", WiFi.SSID(i).c_str());
+                w.field("rssi", (int)WiFi.RSSI(i));
+                w.endObject();
             }
             // Yield some cpu cycles to IP stack.
             //   This is important in case the list is large and it takes us time to return
@@ -842,14 +872,7 @@ void handleScanNetworks(HTTPRequest *req, HTTPResponse *res)
             yield();
         }
     }
-
-    // build output structure
-    JSONObject jsonObjOuter;
-    jsonObjOuter["data"] = new JSONValue(networkObjs);
-    jsonObjOuter["status"] = new JSONValue("ok");
-
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObjOuter);
-    res->print(value->Stringify().c_str());
-    delete value;
+    w.endArray();
+    w.field("status", "ok");
+    w.endObject();
 }
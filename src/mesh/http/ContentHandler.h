@@ -1,7 +1,8 @@
 #pragma once
 
 
-void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer);
+/// Register all our URLs with server (the HTTPS server is an HTTPServer too, so this is called once for each)
+void registerHandlers(HTTPServer *server);
 
 // Declare some handler functions for the various URLs on the server
 void handleAPIv1FromRadio(HTTPRequest *req, HTTPResponse *res);
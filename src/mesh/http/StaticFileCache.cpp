@@ -0,0 +1,78 @@
+#include "configuration.h"
+#include "mesh/http/StaticFileCache.h"
+
+StaticFileCache staticFileCache;
+
+size_t StaticFileCache::budget()
+{
+    return psramFound() ? STATIC_CACHE_PSRAM_SIZE : STATIC_CACHE_HEAP_SIZE;
+}
+
+void StaticFileCache::evict(Entry &e)
+{
+    free(e.data);
+    used -= e.size;
+    e = Entry();
+}
+
+const StaticFileCache::Entry *StaticFileCache::find(const std::string &path)
+{
+    for (auto &e : entries)
+        if (e.data && e.path == path) {
+            e.lastUsed = ++useCounter;
+            return &e;
+        }
+
+    return NULL;
+}
+
+const StaticFileCache::Entry *StaticFileCache::add(const std::string &path, bool gzip, const char *etag, File &file)
+{
+    // Keep room for at least a couple of files, one huge one shouldn't push out everything else
+    size_t size = file.size();
+    if (!size || size > budget() / 2)
+        return NULL;
+
+    // Free the oldest entries until both a slot and the bytes are available
+    Entry *slot = NULL;
+    while (true) {
+        Entry *oldest = NULL;
+        slot = NULL;
+        for (auto &e : entries) {
+            if (!e.data)
+                slot = &e;
+            else if (!oldest || e.lastUsed < oldest->lastUsed)
+                oldest = &e;
+        }
+        if (slot && used + size <= budget())
+            break;
+        LOG_DEBUG("Static cache evicting %s\n", oldest->path.c_str());
+        evict(*oldest);
+    }
+
+    uint8_t *data = static_cast<uint8_t *>(psramFound() ? ps_malloc(size) : malloc(size));
+    if (!data)
+        return NULL;
+    if (file.read(data, size) != size) {
+        free(data);
+        file.seek(0);
+        return NULL;
+    }
+
+    slot->path = path;
+    slot->gzip = gzip;
+    strncpy(slot->etag, etag, sizeof(slot->etag) - 1);
+    slot->data = data;
+    slot->size = size;
+    slot->lastUsed = ++useCounter;
+    used += size;
+    LOG_DEBUG("Static cache added %s (%u bytes, %u in use)\n", path.c_str(), size, used);
+    return slot;
+}
+
+void StaticFileCache::clear()
+{
+    for (auto &e : entries)
+        if (e.data)
+            evict(e);
+}
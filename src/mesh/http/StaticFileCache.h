@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FSCommon.h>
+#include <string>
+
+#define STATIC_CACHE_ENTRIES 8
+
+/// Total bytes of file contents we keep, in PSRAM if the board has it, otherwise on the (much tighter) heap
+#define STATIC_CACHE_PSRAM_SIZE (512 * 1024)
+#define STATIC_CACHE_HEAP_SIZE (24 * 1024)
+
+/**
+ * A small LRU cache of the hottest gzipped web client files, so serving them again costs neither filesystem reads nor the
+ * main loop time they take.
+ *
+ * Entries are keyed by the path the browser asked for, and also remember which file that resolved to.  Nothing is
+ * revalidated against the filesystem, so anything which changes /static must call clear().
+ */
+class StaticFileCache
+{
+  public:
+    struct Entry {
+        std::string path; // as requested, e.g. /static/index.html
+        bool gzip = false; // true if path was served from path + ".gz"
+        char etag[24] = {0};
+        uint8_t *data = NULL;
+        size_t size = 0;
+        uint32_t lastUsed = 0;
+    };
+
+  private:
+    Entry entries[STATIC_CACHE_ENTRIES];
+    size_t used = 0;
+    uint32_t useCounter = 0;
+
+  public:
+    /// The cached entry for path (marking it most recently used), or NULL
+    const Entry *find(const std::string &path);
+
+    /**
+     * Read file into the cache under path, evicting the least recently used entries to make room.
+     * @return the new entry, or NULL if the file is too big for us or we couldn't get the memory or read it (file is
+     * then left at the start)
+     */
+    const Entry *add(const std::string &path, bool gzip, const char *etag, File &file);
+
+    /// Drop everything, call after changing any file under /static
+    void clear();
+
+  private:
+    size_t budget();
+    void evict(Entry &e);
+};
+
+extern StaticFileCache staticFileCache;
@@ -43,7 +43,18 @@ Preferences prefs;
 using namespace httpsserver;
 #include "mesh/http/ContentHandler.h"
 
-static SSLCert *cert;
+/**
+ * Most HTTPS connections we serve at once.  The server does the whole TLS handshake (seconds of RSA on an ESP32, with the
+ * mesh stalled) when it accepts a connection, so browsers opening half a dozen connections in parallel would queue that many
+ * handshakes back to back.  Beyond this they wait in the listen backlog, and most page loads and API calls then reuse one of
+ * the kept alive connections instead of paying for a handshake of their own.
+ */
+#ifndef WEBSERVER_MAX_SECURE_CONNECTIONS
+#define WEBSERVER_MAX_SECURE_CONNECTIONS 2
+#endif
+
+// Written by the cert task before it sets isCertReady, only read on the main loop after that
+static SSLCert *volatile cert;
 static HTTPSServer *secureServer;
 static HTTPServer *insecureServer;
 
@@ -64,6 +75,8 @@ static void handleWebResponse()
 
 static void taskCreateCert(void *parameter)
 {
+    SSLCert *newCert;
+
     prefs.begin("MeshtasticHTTPS", false);
 
 #if 0
@@ -88,36 +101,40 @@ static void taskCreateCert(void *parameter)
         uint8_t *certBuffer = new uint8_t[certLen];
         prefs.getBytes("cert", certBuffer, certLen);
 
-        cert = new SSLCert(certBuffer, certLen, pkBuffer, pkLen);
+        newCert = new SSLCert(certBuffer, certLen, pkBuffer, pkLen);
 
-        LOG_DEBUG("Retrieved Private Key: %d Bytes\n", cert->getPKLength());
-        LOG_DEBUG("Retrieved Certificate: %d Bytes\n", cert->getCertLength());
+        LOG_DEBUG("Retrieved Private Key: %d Bytes\n", newCert->getPKLength());
+        LOG_DEBUG("Retrieved Certificate: %d Bytes\n", newCert->getCertLength());
 
     } else {
 
         LOG_INFO("Creating the certificate. This may take a while. Please wait...\n");
         yield();
-        cert = new SSLCert();
+        newCert = new SSLCert();
         yield();
-        int createCertResult = createSelfSignedCert(*cert, KEYSIZE_2048, "CN=meshtastic.local,O=Meshtastic,C=US",
+        int createCertResult = createSelfSignedCert(*newCert, KEYSIZE_2048, "CN=meshtastic.local,O=Meshtastic,C=US",
                                                     "20190101000000", "20300101000000");
         yield();
 
         if (createCertResult != 0) {
-            LOG_ERROR("Creating the certificate failed\n");
+            LOG_ERROR("Creating the certificate failed, HTTPS will not be available\n");
+            delete newCert;
+            newCert = NULL;
 
         } else {
             LOG_INFO("Creating the certificate was successful\n");
 
-            LOG_DEBUG("Created Private Key: %d Bytes\n", cert->getPKLength());
+            LOG_DEBUG("Created Private Key: %d Bytes\n", newCert->getPKLength());
 
-            LOG_DEBUG("Created Certificate: %d Bytes\n", cert->getCertLength());
+            LOG_DEBUG("Created Certificate: %d Bytes\n", newCert->getCertLength());
 
-            prefs.putBytes("PK", (uint8_t *)cert->getPKData(), cert->getPKLength());
-            prefs.putBytes("cert", (uint8_t *)cert->getCertData(), cert->getCertLength());
+            prefs.putBytes("PK", (uint8_t *)newCert->getPKData(), newCert->getPKLength());
+            prefs.putBytes("cert", (uint8_t *)newCert->getCertData(), newCert->getCertLength());
         }
     }
 
+    // Publish the finished cert, the main loop won't look at it until isCertReady is set
+    cert = newCert;
     isCertReady = true;
 
     // Must delete self, can't just fall out
@@ -126,43 +143,40 @@ static void taskCreateCert(void *parameter)
 
 void createSSLCert()
 {
-    if (isWifiAvailable() && !isCertReady) {
-        bool runLoop = false;
+    static bool certTaskStarted;
+
+    if (isWifiAvailable() && !isCertReady && !certTaskStarted) {
+        certTaskStarted = true;
 
         // Create a new process just to handle creating the cert.
         //   This is a workaround for Bug: https://github.com/fhessel/esp32_https_server/issues/48
         //  jm@casler.org (Oct 2020)
-        xTaskCreate(taskCreateCert, /* Task function. */
-                    "createCert",   /* String with name of task. */
-                    // 16384,          /* Stack size in bytes. */
-                    8192,  /* Stack size in bytes. */
-                    NULL,  /* Parameter passed as input of the task */
-                    16,    /* Priority of the task. */
-                    NULL); /* Task handle. */
-
-        LOG_DEBUG("Waiting for SSL Cert to be generated.\n");
-        while (!isCertReady) {
-            if ((millis() / 500) % 2) {
-                if (runLoop) {
-                    LOG_DEBUG(".");
-
-                    yield();
-                    esp_task_wdt_reset();
-#if HAS_SCREEN
-                    if (millis() / 1000 >= 3) {
-                        screen->setSSLFrames();
-                    }
-#endif                    
-                }
-                runLoop = false;
-            } else {
-                runLoop = true;
-            }
-        }
-        LOG_INFO("SSL Cert Ready!\n");
+        // Generating a new key takes a long time, so it runs at idle priority on the core the main loop doesn't use and the mesh
+        // carries on meanwhile.  The web server thread starts HTTPS once isCertReady is set, until then we only serve HTTP.
+        xTaskCreatePinnedToCore(taskCreateCert,    /* Task function. */
+                                "createCert",      /* String with name of task. */
+                                8192,              /* Stack size in bytes. */
+                                NULL,              /* Parameter passed as input of the task */
+                                tskIDLE_PRIORITY,  /* Priority of the task. */
+                                NULL,              /* Task handle. */
+                                0);                /* Core, the main loop runs on the other one (if we have two) */
+
+        LOG_DEBUG("Generating the SSL Cert in the background\n");
     }
 }
 
+/// Bring up HTTPS once the certificate is ready, on top of the HTTP server which is already running
+static void startSecureServer()
+{
+    secureServer = new HTTPSServer(cert, 443, WEBSERVER_MAX_SECURE_CONNECTIONS);
+    registerHandlers(secureServer);
+
+    LOG_INFO("Starting Secure Web Server...\n");
+    secureServer->start();
+    if (!secureServer->isRunning())
+        LOG_ERROR("Secure Web Server Failed!\n");
+}
+
 WebServerThread *webServerThread;
 
 WebServerThread::WebServerThread() : concurrency::OSThread("WebServerThread") {
@@ -177,9 +191,15 @@ int32_t WebServerThread::runOnce()
         disable();
     }
 
+    if (isWebServerReady && !secureServer && isCertReady && cert) {
+        LOG_INFO("SSL Cert Ready!\n");
+        startSecureServer();
+    }
+
     handleWebResponse();
 
     if (requestRestart && (millis() / 1000) > requestRestart) {
+        nodeDB.flushSaves();
         ESP.restart();
     }
 
@@ -191,16 +211,10 @@ void initWebServer()
 {
     LOG_DEBUG("Initializing Web Server ...\n");
 
-    // We can now use the new certificate to setup our server as usual.
-    secureServer = new HTTPSServer(cert);
+    // HTTPS is started by WebServerThread once the certificate is ready, which may take a while if it is being generated
     insecureServer = new HTTPServer();
+    registerHandlers(insecureServer);
 
-    registerHandlers(insecureServer, secureServer);
-
-    if (secureServer) {
-        LOG_INFO("Starting Secure Web Server...\n");
-        secureServer->start();
-    }
     LOG_INFO("Starting Insecure Web Server...\n");
     insecureServer->start();
     if (insecureServer->isRunning()) {
@@ -1,5 +1,4 @@
 #include "mesh-pb-constants.h"
-#include "FSCommon.h"
 #include "configuration.h"
 #include <Arduino.h>
 #include <assert.h>
@@ -31,36 +30,6 @@ bool pb_decode_from_bytes(const uint8_t *srcbuf, size_t srcbufsize, const pb_msg
     }
 }
 
-#ifdef FSCom
-/// Read from an Arduino File
-bool readcb(pb_istream_t *stream, uint8_t *buf, size_t count)
-{
-    bool status = false;
-    File *file = (File *)stream->state;
-
-    if (buf == NULL) {
-        while (count-- && file->read() != EOF)
-            ;
-        return count == 0;
-    }
-
-    status = (file->read(buf, count) == (int)count);
-
-    if (file->available() == 0)
-        stream->bytes_left = 0;
-
-    return status;
-}
-
-/// Write to an arduino file
-bool writecb(pb_ostream_t *stream, const uint8_t *buf, size_t count)
-{
-    File *file = (File *)stream->state;
-    // LOG_DEBUG("writing %d bytes to protobuf file\n", count);
-    return file->write(buf, count) == count;
-}
-#endif
-
 bool is_in_helper(uint32_t n, const uint32_t *array, pb_size_t count)
 {
     for (pb_size_t i = 0; i < count; i++)
@@ -30,6 +30,7 @@ class RoutingModule : public ProtobufModule<Routing>
 
     /// Override wantPacket to say we want to see all packets, not just those for our port number
     virtual bool wantPacket(const MeshPacket *p) override { return true; }
+    virtual bool wantPortNum(PortNum portnum) override { return true; }
 };
 
 extern RoutingModule *routingModule;
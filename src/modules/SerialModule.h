@@ -58,6 +58,8 @@ class SerialModuleRadio : public MeshModule
 
     virtual bool wantPacket(const MeshPacket *p) override { return p->decoded.portnum == ourPortNum; }
 
+    virtual bool wantPortNum(PortNum portnum) override { return portnum == ourPortNum; }
+
     MeshPacket *allocDataPacket()
     {
         // Update our local node info with our position (even if we don't decide to update anyone else)
@@ -26,6 +26,9 @@ uint32_t packetSequence = 0;
 #define SEC_PER_HOUR 3600
 #define SEC_PER_MIN 60
 
+static const char *logFileName = "/static/rangetest.csv";
+static const char *oldLogFileName = "/static/rangetest.old.csv";
+
 int32_t RangeTestModule::runOnce()
 {
 #ifdef ARCH_ESP32
@@ -53,31 +56,44 @@ int32_t RangeTestModule::runOnce()
 
             if (moduleConfig.range_test.sender) {
                 LOG_INFO("Initializing Range Test Module -- Sender\n");
+                lastSendMsec = millis() + 5000 - senderHeartbeat; // So the first heartbeat is due in 5 seconds
                 return (5000); // Sending first message 5 seconds after initilization.
             } else {
                 LOG_INFO("Initializing Range Test Module -- Receiver\n");
-                return (INT32_MAX);
-                // This thread does not need to run as a receiver
+                // As a receiver this thread only writes out the log
+                return moduleConfig.range_test.save ? RANGETEST_LOG_CHECK_MSEC : INT32_MAX;
             }
 
         } else {
 
             if (moduleConfig.range_test.sender) {
                 // If sender
-                LOG_INFO("Range Test Module - Sending heartbeat every %d ms\n", (senderHeartbeat));
-
-                LOG_INFO("gpsStatus->getLatitude()     %d\n", gpsStatus->getLatitude());
-                LOG_INFO("gpsStatus->getLongitude()    %d\n", gpsStatus->getLongitude());
-                LOG_INFO("gpsStatus->getHasLock()      %d\n", gpsStatus->getHasLock());
-                LOG_INFO("gpsStatus->getDOP()          %d\n", gpsStatus->getDOP());
-                LOG_INFO("fixed_position()             %d\n", config.position.fixed_position);
-
-                // Only send packets if the channel is less than 25% utilized.
-                if (airTime->isTxAllowedChannelUtil(true)) {
-                    rangeTestModuleRadio->sendPayload();
+                if (millis() - lastSendMsec >= senderHeartbeat) {
+                    lastSendMsec = millis();
+                    LOG_INFO("Range Test Module - Sending heartbeat every %d ms\n", (senderHeartbeat));
+
+                    LOG_INFO("gpsStatus->getLatitude()     %d\n", gpsStatus->getLatitude());
+                    LOG_INFO("gpsStatus->getLongitude()    %d\n", gpsStatus->getLongitude());
+                    LOG_INFO("gpsStatus->getHasLock()      %d\n", gpsStatus->getHasLock());
+                    LOG_INFO("gpsStatus->getDOP()          %d\n", gpsStatus->getDOP());
+                    LOG_INFO("fixed_position()             %d\n", config.position.fixed_position);
+
+                    // Only send packets if the channel is less than 25% utilized.
+                    if (airTime->isTxAllowedChannelUtil(true)) {
+                        rangeTestModuleRadio->sendPayload();
+                    }
                 }
 
-                return (senderHeartbeat);
+                uint32_t untilSend = senderHeartbeat - (millis() - lastSendMsec);
+                if (moduleConfig.range_test.save) {
+                    // Senders log what they hear too, so they also need the rows written out
+                    rangeTestModuleRadio->flushFile(false);
+                    return min(untilSend, (uint32_t)RANGETEST_LOG_CHECK_MSEC);
+                }
+                return untilSend;
+            } else if (moduleConfig.range_test.save) {
+                rangeTestModuleRadio->flushFile(false);
+                return RANGETEST_LOG_CHECK_MSEC;
             } else {
                 return disable();
                 // This thread does not need to run as a receiver
@@ -207,46 +223,8 @@ bool RangeTestModuleRadio::appendFile(const MeshPacket &mp)
         LOG_DEBUG("gpsStatus->getDOP()          %d\n", gpsStatus->getDOP());
         LOG_DEBUG("-----------------------------------------\n");
     */
-    if (!FSBegin()) {
-        LOG_DEBUG("An Error has occurred while mounting the filesystem\n");
-        return 0;
-    }
-
-    if (FSCom.totalBytes() - FSCom.usedBytes() < 51200) {
-        LOG_DEBUG("Filesystem doesn't have enough free space. Aborting write.\n");
-        return 0;
-    }
-
-    FSCom.mkdir("/static");
-
-    // If the file doesn't exist, write the header.
-    if (!FSCom.exists("/static/rangetest.csv")) {
-        //--------- Write to file
-        File fileToWrite = FSCom.open("/static/rangetest.csv", FILE_WRITE);
-
-        if (!fileToWrite) {
-            LOG_ERROR("There was an error opening the file for writing\n");
-            return 0;
-        }
-
-        // Print the CSV header
-        if (fileToWrite.println(
-                "time,from,sender name,sender lat,sender long,rx lat,rx long,rx elevation,rx snr,distance,hop limit,payload")) {
-            LOG_INFO("File was written\n");
-        } else {
-            LOG_ERROR("File write failed\n");
-        }
-
-        fileToWrite.close();
-    }
-
-    //--------- Append content to file
-    File fileToAppend = FSCom.open("/static/rangetest.csv", FILE_APPEND);
-
-    if (!fileToAppend) {
-        LOG_ERROR("There was an error opening the file for appending\n");
-        return 0;
-    }
+    char row[RANGETEST_LOG_ROW_MAX];
+    int len = 0;
 
     struct timeval tv;
     if (!gettimeofday(&tv, NULL)) {
@@ -258,34 +236,85 @@ bool RangeTestModuleRadio::appendFile(const MeshPacket &mp)
         int min = (hms % SEC_PER_HOUR) / SEC_PER_MIN;
         int sec = (hms % SEC_PER_HOUR) % SEC_PER_MIN; // or hms % SEC_PER_MIN
 
-        fileToAppend.printf("%02d:%02d:%02d,", hour, min, sec); // Time
+        len = snprintf(row, sizeof(row), "%02d:%02d:%02d,", hour, min, sec); // Time
     } else {
-        fileToAppend.printf("??:??:??,"); // Time
+        len = snprintf(row, sizeof(row), "??:??:??,"); // Time
     }
 
-    fileToAppend.printf("%d,", getFrom(&mp));                     // From
-    fileToAppend.printf("%s,", n->user.long_name);                // Long Name
-    fileToAppend.printf("%f,", n->position.latitude_i * 1e-7);    // Sender Lat
-    fileToAppend.printf("%f,", n->position.longitude_i * 1e-7);   // Sender Long
-    fileToAppend.printf("%f,", gpsStatus->getLatitude() * 1e-7);  // RX Lat
-    fileToAppend.printf("%f,", gpsStatus->getLongitude() * 1e-7); // RX Long
-    fileToAppend.printf("%d,", gpsStatus->getAltitude());         // RX Altitude
-
-    fileToAppend.printf("%f,", mp.rx_snr); // RX SNR
-
+    float distance = 0;
     if (n->position.latitude_i && n->position.longitude_i && gpsStatus->getLatitude() && gpsStatus->getLongitude()) {
-        float distance = GeoCoord::latLongToMeter(n->position.latitude_i * 1e-7, n->position.longitude_i * 1e-7,
-                                                  gpsStatus->getLatitude() * 1e-7, gpsStatus->getLongitude() * 1e-7);
-        fileToAppend.printf("%f,", distance); // Distance in meters
-    } else {
-        fileToAppend.printf("0,");
+        distance = GeoCoord::latLongToMeter(n->position.latitude_i * 1e-7, n->position.longitude_i * 1e-7,
+                                            gpsStatus->getLatitude() * 1e-7, gpsStatus->getLongitude() * 1e-7);
     }
 
-    fileToAppend.printf("%d,", mp.hop_limit); // Packet Hop Limit
-
     // TODO: If quotes are found in the payload, it has to be escaped.
-    fileToAppend.printf("\"%s\"\n", p.payload.bytes);
-    fileToAppend.close();
+    len += snprintf(row + len, sizeof(row) - len, "%d,%s,%f,%f,%f,%f,%d,%f,%f,%d,\"%.*s\"\n",
+                    getFrom(&mp),                     // From
+                    n->user.long_name,                // Long Name
+                    n->position.latitude_i * 1e-7,    // Sender Lat
+                    n->position.longitude_i * 1e-7,   // Sender Long
+                    gpsStatus->getLatitude() * 1e-7,  // RX Lat
+                    gpsStatus->getLongitude() * 1e-7, // RX Long
+                    gpsStatus->getAltitude(),         // RX Altitude
+                    mp.rx_snr,                        // RX SNR
+                    distance,                         // Distance in meters (0 if unknown)
+                    mp.hop_limit,                     // Packet Hop Limit
+                    p.payload.size, p.payload.bytes);
+    if (len >= (int)sizeof(row)) {
+        len = sizeof(row) - 1;
+        row[len - 1] = '\n';
+    }
+
+    // Normally the thread writes the buffer out in the background, we only do it here if it can't keep up
+    if (logLen + len > sizeof(logBuf))
+        flushFile();
+    if (logLen + len > sizeof(logBuf)) {
+        LOG_ERROR("Can't write the range test log, discarding %u bytes\n", (unsigned)logLen);
+        logLen = 0;
+    }
+    if (!logLen)
+        logFirstMsec = millis();
+    memcpy(logBuf + logLen, row, len);
+    logLen += len;
 
     return 1;
 }
+
+void RangeTestModuleRadio::flushFile(bool force)
+{
+    if (!logLen || (!force && logLen < RANGETEST_LOG_FLUSH_SIZE && millis() - logFirstMsec < RANGETEST_LOG_FLUSH_MSEC))
+        return;
+
+    // Running low on space: drop the previous log (if any) and start a new one, keeping what we just wrote as the old log
+    if (FSCom.totalBytes() - FSCom.usedBytes() < RANGETEST_LOG_MIN_FREE) {
+        if (FSCom.exists(oldLogFileName))
+            FSCom.remove(oldLogFileName);
+        if (FSCom.exists(logFileName) && renameFile(logFileName, oldLogFileName))
+            LOG_INFO("Filesystem is getting full, rotated %s\n", logFileName);
+
+        if (FSCom.totalBytes() - FSCom.usedBytes() < RANGETEST_LOG_MIN_FREE) {
+            LOG_WARN("Filesystem doesn't have enough free space, discarding %u bytes of range test log\n", (unsigned)logLen);
+            logLen = 0;
+            return;
+        }
+    }
+
+    FSCom.mkdir("/static");
+
+    // If the file doesn't exist, write the header.
+    bool isNew = !FSCom.exists(logFileName);
+    File f = FSCom.open(logFileName, isNew ? FILE_WRITE : FILE_APPEND);
+    if (!f) {
+        LOG_ERROR("There was an error opening %s\n", logFileName);
+        return; // Keep the rows, we try again next time
+    }
+
+    // Print the CSV header
+    if (isNew)
+        f.println("time,from,sender name,sender lat,sender long,rx lat,rx long,rx elevation,rx snr,distance,hop limit,payload");
+
+    if (f.write((const uint8_t *)logBuf, logLen) != logLen)
+        LOG_ERROR("Range test log write failed\n");
+    f.close();
+    logLen = 0;
+}
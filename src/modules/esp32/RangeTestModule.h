@@ -6,10 +6,26 @@
 #include <Arduino.h>
 #include <functional>
 
+/// Received rows are collected in RAM and written out once this many bytes are waiting...
+#define RANGETEST_LOG_FLUSH_SIZE 2048
+/// ...or the oldest has waited this long
+#define RANGETEST_LOG_FLUSH_MSEC (30 * 1000)
+/// How often the thread checks whether to write the rows
+#define RANGETEST_LOG_CHECK_MSEC 1000
+
+#define RANGETEST_LOG_BUFFER_SIZE 4096
+#define RANGETEST_LOG_ROW_MAX 512
+
+/// Below this much free space we rotate the log (dropping the previous one) and, if that isn't enough, stop writing
+#define RANGETEST_LOG_MIN_FREE 51200
+
 class RangeTestModule : private concurrency::OSThread
 {
     bool firstTime = 1;
 
+    /// When the sender last sent, we may run more often than that to write out the log
+    uint32_t lastSendMsec = 0;
+
   public:
     RangeTestModule();
 
@@ -27,6 +43,11 @@ class RangeTestModuleRadio : public SinglePortModule
 {
     uint32_t lastRxID = 0;
 
+    /// CSV rows not yet written to the file
+    char logBuf[RANGETEST_LOG_BUFFER_SIZE];
+    size_t logLen = 0;
+    uint32_t logFirstMsec = 0;
+
   public:
     RangeTestModuleRadio() : SinglePortModule("RangeTestModuleRadio", PortNum_TEXT_MESSAGE_APP)
     {
@@ -39,10 +60,15 @@ class RangeTestModuleRadio : public SinglePortModule
     void sendPayload(NodeNum dest = NODENUM_BROADCAST, bool wantReplies = false);
 
     /**
-     * Append range test data to the file on the Filesystem
+     * Append range test data to the file on the Filesystem (buffered, see flushFile)
      */
     bool appendFile(const MeshPacket &mp);
 
+    /**
+     * Write the buffered rows to the file, unless force is set only once enough are waiting or the oldest is old enough
+     */
+    void flushFile(bool force = true);
+
     /**
      * Kevin's magical calculation of two points to meters.
      */
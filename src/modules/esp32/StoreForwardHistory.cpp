@@ -0,0 +1,233 @@
+#include "configuration.h"
+#include "StoreForwardHistory.h"
+#include "FSCommon.h"
+#include "RTC.h"
+#include <ErriezCRC32.h>
+
+static_assert(Constants_DATA_PAYLOAD_LEN <= UINT8_MAX, "StoreForwardRecord.payload_size is a byte");
+
+static const char *logFileName = "/prefs/storeforward.log";
+
+/// A record with room for the biggest payload
+static union {
+    StoreForwardRecord r;
+    uint8_t bytes[sizeof(StoreForwardRecord) + Constants_DATA_PAYLOAD_LEN];
+} scratch;
+
+/// Bytes a record takes in the flash log
+static uint32_t logRecordSize(const StoreForwardRecord *r)
+{
+    return sizeof(*r) + r->payload_size;
+}
+
+/// Bytes a record takes in the ring, rounded up so every header stays 4 byte aligned
+static uint32_t ringRecordSize(const StoreForwardRecord *r)
+{
+    return (logRecordSize(r) + 3) & ~3;
+}
+
+#ifdef FSCom
+/// Append a record to the flash log, with its crc filled in
+static bool writeLogRecord(File &f, const StoreForwardRecord *r)
+{
+    uint32_t n = logRecordSize(r);
+    memcpy(scratch.bytes, r, n);
+    scratch.r.crc = 0;
+    scratch.r.crc = crc32Buffer(scratch.bytes, n);
+    return f.write(scratch.bytes, n) == n;
+}
+#endif
+
+bool StoreForwardHistory::init(uint32_t _dataSize, uint32_t _maxRecords)
+{
+    data = static_cast<uint8_t *>(ps_malloc(_dataSize));
+    offsets = static_cast<uint32_t *>(ps_calloc(_maxRecords, sizeof(uint32_t)));
+    if (!data || !offsets) {
+        free(data);
+        free(offsets);
+        data = NULL;
+        offsets = NULL;
+        return false;
+    }
+
+    dataSize = _dataSize & ~3;
+    maxRecords = _maxRecords;
+    return true;
+}
+
+void StoreForwardHistory::store(const StoreForwardRecord *r)
+{
+    uint32_t n = ringRecordSize(r);
+    if (n > dataSize)
+        return;
+    if (writePos + n > dataSize) {
+        // Not enough room before the end of the ring: drop whatever still lives up there and start again from the bottom
+        while (getCount() && offsets[firstSeq % maxRecords] >= writePos)
+            firstSeq++;
+        writePos = 0;
+    }
+
+    // Live records now run from the oldest one up to writePos (perhaps wrapping), so the oldest is the first we collide with
+    while (getCount()) {
+        uint32_t oldest = offsets[firstSeq % maxRecords];
+        if (getCount() < maxRecords && (oldest < writePos || oldest >= writePos + n))
+            break;
+        firstSeq++;
+    }
+
+    memcpy(data + writePos, r, logRecordSize(r));
+    offsets[nextSeq % maxRecords] = writePos;
+    nextSeq++;
+    writePos += n;
+}
+
+void StoreForwardHistory::add(const MeshPacket &mp)
+{
+    if (!data)
+        return;
+
+    StoreForwardRecord *r = &scratch.r;
+    memset(r, 0, sizeof(*r));
+    r->time = getTime();
+    if (getCount() && r->time < get(nextSeq - 1)->time)
+        r->time = get(nextSeq - 1)->time; // Our clock went backwards, keep the history sorted anyway
+    r->to = mp.to;
+    r->from = mp.from;
+    r->channel = mp.channel;
+    r->payload_size = mp.decoded.payload.size;
+    memcpy(r + 1, mp.decoded.payload.bytes, r->payload_size);
+    if (loggedSeq == nextSeq)
+        unloggedMsec = millis();
+    store(r);
+}
+
+void StoreForwardHistory::flushLog(bool force)
+{
+#ifdef FSCom
+    if (!data || loggedSeq == nextSeq)
+        return;
+
+    // The ring overwrote some before we got to them, they're gone anyway
+    if (loggedSeq < firstSeq) {
+        LOG_WARN("*** S&F - %u messages were overwritten before reaching flash\n", firstSeq - loggedSeq);
+        loggedSeq = firstSeq;
+    }
+
+    size_t pending = 0;
+    for (uint32_t seq = loggedSeq; seq != nextSeq; seq++)
+        pending += logRecordSize(get(seq));
+    if (!force && pending < STOREFORWARD_LOG_FLUSH_SIZE && millis() - unloggedMsec < STOREFORWARD_LOG_FLUSH_MSEC)
+        return;
+
+    if (logSize + pending > STOREFORWARD_LOG_MAX_SIZE) {
+        compactLog(); // This includes everything waiting
+        return;
+    }
+
+    FSCom.mkdir("/prefs");
+    auto f = FSCom.open(logFileName, FILE_O_APPEND);
+    if (!f) {
+        LOG_ERROR("Can't append to %s\n", logFileName);
+        return;
+    }
+    while (loggedSeq != nextSeq && writeLogRecord(f, get(loggedSeq)))
+        loggedSeq++;
+    if (loggedSeq != nextSeq)
+        LOG_ERROR("Can't write %s\n", logFileName);
+    logSize = f.size();
+    f.close();
+    LOG_DEBUG("*** S&F - Wrote %u bytes of history to flash\n", pending);
+#endif
+}
+
+void StoreForwardHistory::load()
+{
+#ifdef FSCom
+    if (!data)
+        return;
+
+    auto f = FSCom.open(logFileName, FILE_O_READ);
+    if (!f)
+        return;
+
+    StoreForwardRecord *r = &scratch.r;
+    size_t goodSize = 0;
+    while (f.read(scratch.bytes, sizeof(*r)) == sizeof(*r)) {
+        if (r->payload_size > Constants_DATA_PAYLOAD_LEN ||
+            f.read(scratch.bytes + sizeof(*r), r->payload_size) != r->payload_size)
+            break;
+
+        uint32_t crc = r->crc;
+        r->crc = 0;
+        if (crc32Buffer(r, logRecordSize(r)) != crc)
+            break;
+
+        goodSize += logRecordSize(r);
+        store(r);
+    }
+    logSize = f.size();
+    f.close();
+    loggedSeq = nextSeq;
+
+    LOG_INFO("*** S&F - Restored %u messages from flash\n", getCount());
+    if (goodSize != logSize) {
+        // Rewrite it, anything appended after the damage would never be read back
+        LOG_WARN("*** S&F - Ignoring the torn end of %s\n", logFileName);
+        compactLog();
+    }
+#endif
+}
+
+uint32_t StoreForwardHistory::findTime(uint32_t time) const
+{
+    uint32_t lo = firstSeq, hi = nextSeq;
+    while (lo != hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (get(mid)->time < time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void StoreForwardHistory::compactLog()
+{
+#ifdef FSCom
+    // Keep as many of the newest records as fit in half the limit
+    uint32_t seq = nextSeq;
+    size_t size = 0;
+    while (seq != firstSeq && size + logRecordSize(get(seq - 1)) <= STOREFORWARD_LOG_MAX_SIZE / 2)
+        size += logRecordSize(get(--seq));
+
+    // Write the new log beside the old one, so failing part way through loses nothing
+    String filenameTmp = logFileName;
+    filenameTmp += ".tmp";
+    FSCom.mkdir("/prefs");
+    auto f = FSCom.open(filenameTmp.c_str(), FILE_O_WRITE);
+    if (!f) {
+        LOG_ERROR("Can't write %s\n", filenameTmp.c_str());
+        return;
+    }
+
+    bool okay = true;
+    for (; okay && seq != nextSeq; seq++)
+        okay = writeLogRecord(f, get(seq));
+    size_t newSize = f.size();
+    f.close();
+    if (!okay) {
+        LOG_ERROR("Can't write %s\n", filenameTmp.c_str());
+        return;
+    }
+
+    // brief window of risk here, as with the prefs files
+    if (FSCom.exists(logFileName) && !FSCom.remove(logFileName))
+        LOG_WARN("Can't remove %s\n", logFileName);
+    if (!renameFile(filenameTmp.c_str(), logFileName)) {
+        LOG_ERROR("Can't rename %s\n", filenameTmp.c_str());
+        return;
+    }
+    logSize = newSize;
+    loggedSeq = nextSeq;
+#endif
+}
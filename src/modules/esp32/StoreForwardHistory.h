@@ -0,0 +1,98 @@
+#pragma once
+
+#include "MeshTypes.h"
+
+/// The history log in flash is compacted (down to about half this) once it grows past this size
+#define STOREFORWARD_LOG_MAX_SIZE (128 * 1024)
+
+/// New records are appended to the flash log in batches, once this many bytes are waiting or the oldest has waited this long
+#define STOREFORWARD_LOG_FLUSH_SIZE 2048
+#define STOREFORWARD_LOG_FLUSH_MSEC (60 * 1000)
+
+/**
+ * Header of each stored message, followed by payload_size bytes of payload.
+ */
+struct StoreForwardRecord {
+    uint32_t time; // getTime() when we heard it, never less than the record before so the history stays sorted by time
+    uint32_t to;
+    uint32_t from;
+    uint8_t channel;
+    uint8_t payload_size;
+    uint16_t reserved;
+    uint32_t crc; // in the flash log only: crc32 of the record (with crc = 0) and payload, a torn record fails this
+};
+
+/**
+ * The Store & Forward router's message history.
+ *
+ * Messages are kept as variable length records in a byte ring in PSRAM, so a short message only costs its own length, and
+ * once the ring is full the oldest records are overwritten.  Each record gets a sequence number and a small index maps
+ * sequence numbers to ring offsets.  Records are appended in time order, so finding the start of a history window is a
+ * binary search, and senders walk the ring from there with a sequence number cursor instead of copying matches out.
+ *
+ * Every record is also appended to a log in flash, which load() replays at boot so the history survives a reboot.  The
+ * ring doubles as the write buffer for that log: records past loggedSeq are appended by flushLog() in one go.
+ */
+class StoreForwardHistory
+{
+    uint8_t *data = NULL;
+    uint32_t dataSize = 0;
+
+    /// Ring offset of record seq is offsets[seq % maxRecords]
+    uint32_t *offsets = NULL;
+    uint32_t maxRecords = 0;
+
+    /// Sequence numbers of the oldest record we still hold and of the next one we will add
+    uint32_t firstSeq = 0, nextSeq = 0;
+
+    /// Where the next record goes in data
+    uint32_t writePos = 0;
+
+    /// Bytes in the flash log
+    size_t logSize = 0;
+
+    /// Records from this sequence number on are not in the flash log yet, the first of them was added at unloggedMsec
+    uint32_t loggedSeq = 0;
+    uint32_t unloggedMsec = 0;
+
+  public:
+    /// Allocate the ring and its index in PSRAM, returns false if we couldn't
+    bool init(uint32_t _dataSize, uint32_t _maxRecords);
+
+    /// Replay the flash log into the ring
+    void load();
+
+    /// Store a text message we heard (it reaches flash with the next flushLog)
+    void add(const MeshPacket &mp);
+
+    /**
+     * Append the records added since the last flush to the flash log.
+     * @param force write even a small batch right away (e.g. before a reboot), otherwise only once a batch is due
+     */
+    void flushLog(bool force = true);
+
+    /// Number of messages we hold
+    uint32_t getCount() const { return nextSeq - firstSeq; }
+
+    /// Most messages we could hold (if they were all short)
+    uint32_t getMaxRecords() const { return maxRecords; }
+
+    /// The oldest sequence number still held, cursors from before this have been overwritten
+    uint32_t getFirstSeq() const { return firstSeq; }
+
+    /// The sequence number of the first message heard at or after time (getEnd() if there is none)
+    uint32_t findTime(uint32_t time) const;
+
+    /// One past the newest sequence number
+    uint32_t getEnd() const { return nextSeq; }
+
+    /// The record with sequence number seq (which must be >= getFirstSeq() and < getEnd()), its payload follows it
+    const StoreForwardRecord *get(uint32_t seq) const { return (const StoreForwardRecord *)(data + offsets[seq % maxRecords]); }
+
+  private:
+    /// Put a record (whose payload follows it in memory) into the ring, evicting the oldest records to make room
+    void store(const StoreForwardRecord *r);
+
+    /// Replace the flash log with the newest records which fit in half of STOREFORWARD_LOG_MAX_SIZE
+    void compactLog();
+};
@@ -18,25 +18,12 @@ int32_t StoreForwardModule::runOnce()
 {
 #ifdef ARCH_ESP32
     if (moduleConfig.store_forward.enabled && is_server) {
+        history.flushLog(false);
+
         // Send out the message queue.
         if (this->busy) {
-            // Only send packets if the channel is less than 25% utilized.
-            if (airTime->isTxAllowedChannelUtil(true)) {
-                storeForwardModule->sendPayload(this->busyTo, this->packetHistoryTXQueue_index);
-                if (this->packetHistoryTXQueue_index == packetHistoryTXQueue_size) {
-                    // Tell the client we're done sending
-                    StoreAndForward sf = StoreAndForward_init_zero;
-                    sf.rr = StoreAndForward_RequestResponse_ROUTER_PING;
-                    storeForwardModule->sendMessage(this->busyTo, sf);
-                    LOG_INFO("*** S&F - Done. (ROUTER_PING)\n");
-                    this->packetHistoryTXQueue_index = 0;
-                    this->busy = false;
-                } else {
-                    this->packetHistoryTXQueue_index++;
-                }
-            }
             LOG_DEBUG("*** SF bitrate = %f bytes / sec\n", myNodeInfo.bitrate);
-
+            return replayNext();
         } else if ((millis() - lastHeartbeat > (heartbeatInterval * 1000)) && airTime->isTxAllowedChannelUtil(true)) {
             lastHeartbeat = millis();
             LOG_INFO("*** Sending heartbeat\n");
@@ -53,10 +40,45 @@ int32_t StoreForwardModule::runOnce()
     return disable();
 }
 
+/**
+ * Send the next history message, if the channel and our TX queue have room for it.
+ * @return how long to wait before trying again
+ */
+int32_t StoreForwardModule::replayNext()
+{
+    // Hold our place while the channel is over the polite limit, or the radio still has a backlog of ours to get through
+    QueueStatus qs = router->getQueueStatus();
+    if (!airTime->isTxAllowedChannelUtil(true) || qs.free < qs.maxlen / 2) {
+        LOG_DEBUG("*** S&F - Replay paused, channel util %.1f%%, %u/%u TX queue slots free\n", airTime->channelUtilizationPercent(),
+                  qs.free, qs.maxlen);
+        return this->packetTimeMax * STOREFORWARD_REPLAY_MAX_FACTOR;
+    }
+
+    if (!this->txRemaining || !sendPayload(this->busyTo)) {
+        // Tell the client we're done sending
+        StoreAndForward sf = StoreAndForward_init_zero;
+        sf.rr = StoreAndForward_RequestResponse_ROUTER_PING;
+        sendMessage(this->busyTo, sf);
+        LOG_INFO("*** S&F - Done, sent %u message(s) to 0x%x (ROUTER_PING)\n", this->txSent, this->busyTo);
+        this->txRemaining = 0;
+        this->busy = false;
+        return this->packetTimeMax;
+    }
+
+    this->txSent++;
+    LOG_INFO("*** S&F - Sent %u of %u message(s) to 0x%x\n", this->txSent, this->txSent + this->txRemaining, this->busyTo);
+
+    // Never closer than packetTimeMax (as before), spreading out further as we near the polite limit
+    float load = airTime->channelUtilizationPercent() / STOREFORWARD_REPLAY_UTIL_PERCENT;
+    if (load > 1)
+        load = 1;
+    return this->packetTimeMax + (int32_t)(load * (STOREFORWARD_REPLAY_MAX_FACTOR - 1) * this->packetTimeMax);
+}
+
 /*
     Create our data structure in the PSRAM.
 */
-void StoreForwardModule::populatePSRAM()
+bool StoreForwardModule::populatePSRAM()
 {
     /*
     For PSRAM usage, see:
@@ -65,19 +87,34 @@ void StoreForwardModule::populatePSRAM()
 
     LOG_DEBUG("*** Before PSRAM initilization: heap %d/%d PSRAM %d/%d\n", ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getFreePsram(), ESP.getPsramSize());
 
-    this->packetHistoryTXQueue =
-        static_cast<PacketHistoryStruct *>(ps_calloc(this->historyReturnMax, sizeof(PacketHistoryStruct)));
-
-    /* Use a maximum of 2/3 the available PSRAM unless otherwise specified.
+    /* Use a maximum of 2/3 the available PSRAM.
         Note: This needs to be done after every thing that would use PSRAM
     */
-    uint32_t numberOfPackets = (this->records ? this->records : (((ESP.getFreePsram() / 3) * 2) / sizeof(PacketHistoryStruct)));
-    this->records = numberOfPackets;
+    uint32_t budget = (ESP.getFreePsram() / 3) * 2;
+
+    // Records are variable length, so unless told how many to keep we guess at short (32 byte) messages when sizing the
+    // index, each entry of which costs 4 bytes
+    uint32_t numberOfPackets, dataSize;
+    if (this->records) {
+        // Even at their shortest, this many records (and their index) must fit
+        numberOfPackets = min(this->records, budget / (uint32_t)(sizeof(StoreForwardRecord) + 4 + 1));
+        dataSize = min(budget - numberOfPackets * 4, numberOfPackets * (uint32_t)(sizeof(StoreForwardRecord) + Constants_DATA_PAYLOAD_LEN));
+    } else {
+        numberOfPackets = budget / (sizeof(StoreForwardRecord) + 32 + 4);
+        dataSize = budget - numberOfPackets * 4;
+    }
 
-    this->packetHistory = static_cast<PacketHistoryStruct *>(ps_calloc(numberOfPackets, sizeof(PacketHistoryStruct)));
+    bool okay = history.init(dataSize, numberOfPackets);
 
     LOG_DEBUG("*** After PSRAM initilization: heap %d/%d PSRAM %d/%d\n", ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getFreePsram(), ESP.getPsramSize());
-    LOG_DEBUG("*** numberOfPackets for packetHistory - %u\n", numberOfPackets);
+    LOG_DEBUG("*** numberOfPackets for packetHistory - %u (%u bytes)\n", numberOfPackets, dataSize);
+    return okay;
+}
+
+/// Does a history client asking for messages addressed to "to" get this one?
+static bool isHistoryFor(const StoreForwardRecord *r, NodeNum to)
+{
+    return r->to == NODENUM_BROADCAST || r->to == to;
 }
 
 void StoreForwardModule::historySend(uint32_t msAgo, uint32_t to)
@@ -88,6 +125,7 @@ void StoreForwardModule::historySend(uint32_t msAgo, uint32_t to)
         LOG_INFO("*** S&F - Sending %u message(s)\n", queueSize);
         this->busy = true; // runOnce() will pickup the next steps once busy = true.
         this->busyTo = to;
+        this->txSent = 0;
     } else {
         LOG_INFO("*** S&F - No history to send\n");
     }
@@ -101,56 +139,29 @@ void StoreForwardModule::historySend(uint32_t msAgo, uint32_t to)
 
 uint32_t StoreForwardModule::historyQueueCreate(uint32_t msAgo, uint32_t to)
 {
+    // Nothing is copied, we just find where the window starts and count what we will send from there
+    uint32_t now = getTime();
+    uint32_t secsAgo = msAgo / 1000;
+    this->txSeq = history.findTime(now > secsAgo ? now - secsAgo : 0);
+    this->txRemaining = 0;
+
+    // If this client interrupted a replay of the same history, pick up where that one stopped rather than starting over
+    if (to == this->resumeTo && (int32_t)(this->resumeSeq - this->txSeq) > 0 && (int32_t)(history.getEnd() - this->resumeSeq) >= 0) {
+        LOG_INFO("*** S&F - Resuming 0x%x at message %u\n", to, this->resumeSeq - this->txSeq);
+        this->txSeq = this->resumeSeq;
+    }
+    this->resumeTo = 0;
 
-    this->packetHistoryTXQueue_size = 0;
+    for (uint32_t seq = this->txSeq; seq != history.getEnd() && this->txRemaining < this->historyReturnMax; seq++)
+        if (isHistoryFor(history.get(seq), to))
+            this->txRemaining++;
 
-    for (int i = 0; i < this->packetHistoryCurrent; i++) {
-        /*
-            LOG_DEBUG("SF historyQueueCreate\n");
-            LOG_DEBUG("SF historyQueueCreate - time %d\n", this->packetHistory[i].time);
-            LOG_DEBUG("SF historyQueueCreate - millis %d\n", millis());
-            LOG_DEBUG("SF historyQueueCreate - math %d\n", (millis() - msAgo));
-        */
-        if (this->packetHistory[i].time && (this->packetHistory[i].time < (millis() - msAgo))) {
-            LOG_DEBUG("*** SF historyQueueCreate - Time matches - ok\n");
-            /*
-                Copy the messages that were received by the router in the last msAgo
-                to the packetHistoryTXQueue structure.
-
-                TODO: The condition (this->packetHistory[i].to & NODENUM_BROADCAST) == to) is not tested since
-                I don't have an easy way to target a specific user. Will need to do this soon.
-            */
-            if ((this->packetHistory[i].to & NODENUM_BROADCAST) == NODENUM_BROADCAST ||
-                ((this->packetHistory[i].to & NODENUM_BROADCAST) == to)) {
-                this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].time = this->packetHistory[i].time;
-                this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].to = this->packetHistory[i].to;
-                this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].from = this->packetHistory[i].from;
-                this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].channel = this->packetHistory[i].channel;
-                this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].payload_size = this->packetHistory[i].payload_size;
-                memcpy(this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].payload, this->packetHistory[i].payload,
-                       Constants_DATA_PAYLOAD_LEN);
-                this->packetHistoryTXQueue_size++;
-
-                LOG_DEBUG("*** PacketHistoryStruct time=%d\n", this->packetHistory[i].time);
-                LOG_DEBUG("*** PacketHistoryStruct msg=%s\n", this->packetHistory[i].payload);
-            }
-        }
-    }
-    return this->packetHistoryTXQueue_size;
+    return this->txRemaining;
 }
 
 void StoreForwardModule::historyAdd(const MeshPacket &mp)
 {
-    const auto &p = mp.decoded;
-
-    this->packetHistory[this->packetHistoryCurrent].time = millis();
-    this->packetHistory[this->packetHistoryCurrent].to = mp.to;
-    this->packetHistory[this->packetHistoryCurrent].channel = mp.channel;
-    this->packetHistory[this->packetHistoryCurrent].from = mp.from;
-    this->packetHistory[this->packetHistoryCurrent].payload_size = p.payload.size;
-    memcpy(this->packetHistory[this->packetHistoryCurrent].payload, p.payload.bytes, Constants_DATA_PAYLOAD_LEN);
-
-    this->packetHistoryCurrent++;
+    history.add(mp);
     this->packetHistoryMax++;
 }
 
@@ -160,25 +171,37 @@ MeshPacket *StoreForwardModule::allocReply()
     return reply;
 }
 
-void StoreForwardModule::sendPayload(NodeNum dest, uint32_t packetHistory_index)
+bool StoreForwardModule::sendPayload(NodeNum dest)
 {
-    LOG_INFO("*** Sending S&F Payload\n");
-    MeshPacket *p = allocReply();
+    // Skip anything the ring overwrote since the request came in
+    if ((int32_t)(this->txSeq - history.getFirstSeq()) < 0)
+        this->txSeq = history.getFirstSeq();
 
-    p->to = dest;
-    p->from = this->packetHistoryTXQueue[packetHistory_index].from;
-    p->channel = this->packetHistoryTXQueue[packetHistory_index].channel;
+    while (this->txSeq != history.getEnd()) {
+        const StoreForwardRecord *r = history.get(this->txSeq++);
+        if (!isHistoryFor(r, dest))
+            continue;
 
-    // Let's assume that if the router received the S&F request that the client is in range.
-    //   TODO: Make this configurable.
-    p->want_ack = false;
+        LOG_INFO("*** Sending S&F Payload\n");
+        MeshPacket *p = allocReply();
 
-    p->decoded.payload.size =
-        this->packetHistoryTXQueue[packetHistory_index].payload_size; // You must specify how many bytes are in the reply
-    memcpy(p->decoded.payload.bytes, this->packetHistoryTXQueue[packetHistory_index].payload,
-           this->packetHistoryTXQueue[packetHistory_index].payload_size);
+        p->to = dest;
+        p->from = r->from;
+        p->channel = r->channel;
 
-    service.sendToMesh(p);
+        // Let's assume that if the router received the S&F request that the client is in range.
+        //   TODO: Make this configurable.
+        p->want_ack = false;
+
+        p->decoded.payload.size = r->payload_size; // You must specify how many bytes are in the reply
+        memcpy(p->decoded.payload.bytes, r + 1, r->payload_size);
+
+        service.sendToMesh(p);
+        this->txRemaining--;
+        return true;
+    }
+
+    return false;
 }
 
 void StoreForwardModule::sendMessage(NodeNum dest, StoreAndForward &payload)
@@ -216,8 +239,8 @@ void StoreForwardModule::statsSend(uint32_t to)
     sf.rr = StoreAndForward_RequestResponse_ROUTER_STATS;
     sf.which_variant = StoreAndForward_stats_tag;
     sf.variant.stats.messages_total = this->packetHistoryMax;
-    sf.variant.stats.messages_saved = this->packetHistoryCurrent;
-    sf.variant.stats.messages_max = this->records;
+    sf.variant.stats.messages_saved = history.getCount();
+    sf.variant.stats.messages_max = history.getMaxRecords();
     sf.variant.stats.up_time = millis() / 1000;
     sf.variant.stats.requests = this->requests;
     sf.variant.stats.requests_history = this->requests_history;
@@ -239,7 +262,7 @@ ProcessMessage StoreForwardModule::handleReceived(const MeshPacket &mp)
 
             if (mp.decoded.portnum == PortNum_TEXT_MESSAGE_APP) {
                 storeForwardModule->historyAdd(mp);
-                LOG_INFO("*** S&F stored. Message history contains %u records now.\n", this->packetHistoryCurrent);
+                LOG_INFO("*** S&F stored. Message history contains %u records now.\n", history.getCount());
 
             } else if (mp.decoded.portnum == PortNum_STORE_FORWARD_APP) {
                 auto &p = mp.decoded;
@@ -279,8 +302,11 @@ bool StoreForwardModule::handleReceivedProtobuf(const MeshPacket &mp, StoreAndFo
             if(is_server) {
                 // stop sending stuff, the client wants to abort or has another error
                 if ((this->busy) && (this->busyTo == getFrom(&mp))) {
-                    LOG_ERROR("*** Client in ERROR or ABORT requested\n");
-                    this->packetHistoryTXQueue_index = 0;
+                    LOG_ERROR("*** Client in ERROR or ABORT requested, after %u of %u message(s)\n", this->txSent,
+                              this->txSent + this->txRemaining);
+                    this->resumeTo = this->busyTo;
+                    this->resumeSeq = this->txSeq;
+                    this->txRemaining = 0;
                     this->busy = false;
                 }
             }
@@ -438,9 +464,13 @@ StoreForwardModule::StoreForwardModule()
                     if (moduleConfig.store_forward.heartbeat)
                         this->heartbeat = moduleConfig.store_forward.heartbeat;
 
-                    // Popupate PSRAM with our data structures.
-                    this->populatePSRAM();
-                    is_server = true;
+                    // Popupate PSRAM with our data structures, and bring back what we stored before we last rebooted
+                    if (this->populatePSRAM()) {
+                        history.load();
+                        is_server = true;
+                    } else {
+                        LOG_ERROR("*** Can't allocate S&F history, disabling server.\n");
+                    }
                 } else {
                     LOG_INFO("*** Device has less than 1M of PSRAM free.\n");
                     LOG_INFO("*** Store & Forward Module - disabling server.\n");
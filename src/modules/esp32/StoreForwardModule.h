@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ProtobufModule.h"
+#include "StoreForwardHistory.h"
 #include "concurrency/OSThread.h"
 #include "mesh/generated/storeforward.pb.h"
 
@@ -8,15 +9,12 @@
 #include <Arduino.h>
 #include <functional>
 
-struct PacketHistoryStruct {
-    uint32_t time;
-    uint32_t to;
-    uint32_t from;
-    uint8_t channel;
-    bool ack;
-    uint8_t payload[Constants_DATA_PAYLOAD_LEN];
-    pb_size_t payload_size;
-};
+/**
+ * History messages we replay are spaced packetTimeMax apart on a quiet channel, stretching to this many times that as
+ * channel utilization reaches STOREFORWARD_REPLAY_UTIL_PERCENT (above that, or with our TX queue half full, we pause)
+ */
+#define STOREFORWARD_REPLAY_MAX_FACTOR 3
+#define STOREFORWARD_REPLAY_UTIL_PERCENT 25.0f
 
 class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<StoreAndForward>
 {
@@ -24,13 +22,18 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
     uint32_t busyTo = 0;
     char routerMessage[Constants_DATA_PAYLOAD_LEN] = {0};
 
-    PacketHistoryStruct *packetHistory = 0;
-    uint32_t packetHistoryCurrent = 0;
+    StoreForwardHistory history;
+    uint32_t packetHistoryCurrent = 0; // Only used on clients, as reported by the router
     uint32_t packetHistoryMax = 0;
 
-    PacketHistoryStruct *packetHistoryTXQueue = 0;
-    uint32_t packetHistoryTXQueue_size = 0;
-    uint32_t packetHistoryTXQueue_index = 0;
+    /// While busy: the next history record to look at, and how many more we will send
+    uint32_t txSeq = 0;
+    uint32_t txRemaining = 0;
+    uint32_t txSent = 0;
+
+    /// The client whose replay was aborted (0 for none), and the record it stopped at
+    NodeNum resumeTo = 0;
+    uint32_t resumeSeq = 0;
 
     uint32_t packetTimeMax = 5000;
 
@@ -48,15 +51,19 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
      @return 0 if we have never seen that node before otherwise return the last time we saw the node.
      */
     void historyAdd(const MeshPacket &mp);
+
+    /// Write any history still waiting for flash, call before a reboot
+    void flushHistory() { history.flushLog(); }
     void statsSend(uint32_t to);
     void historySend(uint32_t msAgo, uint32_t to);
 
     uint32_t historyQueueCreate(uint32_t msAgo, uint32_t to);
 
     /**
-     * Send our payload into the mesh
+     * Send the next history message for dest into the mesh
+     * @return false if there was none left to send
      */
-    void sendPayload(NodeNum dest = NODENUM_BROADCAST, uint32_t packetHistory_index = 0);
+    bool sendPayload(NodeNum dest = NODENUM_BROADCAST);
     void sendMessage(NodeNum dest, StoreAndForward &payload);
     void sendMessage(NodeNum dest, StoreAndForward_RequestResponse rr);
 
@@ -64,9 +71,11 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
     /*
       -Override the wantPacket method.
     */
-    virtual bool wantPacket(const MeshPacket *p) override
+    virtual bool wantPacket(const MeshPacket *p) override { return wantPortNum(p->decoded.portnum); }
+
+    virtual bool wantPortNum(PortNum portnum) override
     {
-        switch(p->decoded.portnum) {
+        switch(portnum) {
             case PortNum_TEXT_MESSAGE_APP:
             case PortNum_STORE_FORWARD_APP:
                 return true;
@@ -76,7 +85,10 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
     }
 
   private:
-    void populatePSRAM();
+    bool populatePSRAM();
+
+    /// Pace out the history replay in progress, returns the interval for runOnce
+    int32_t replayNext();
 
     // S&F Defaults
     uint32_t historyReturnMax = 250; // 250 records
@@ -0,0 +1,357 @@
+#include "JSONReader.h"
+#include <stdlib.h>
+
+bool JSONReader::isJSON(const char *buf, size_t len)
+{
+    JSONReader r(buf, len, NULL, 0);
+    return r.parse();
+}
+
+bool JSONReader::parse()
+{
+    numTokens = 0;
+    if (tokens && jsonLen > UINT16_MAX)
+        return false; // Token offsets are 16 bits
+
+    size_t pos = 0;
+    skipWhitespace(pos);
+    if (!parseValue(pos, 0))
+        return false;
+
+    // Only whitespace may follow the root value
+    skipWhitespace(pos);
+    return pos == jsonLen;
+}
+
+int JSONReader::addToken(JSONType type, size_t start)
+{
+    if (!tokens)
+        return -1;
+    if (numTokens >= maxTokens)
+        return -2;
+
+    JSONToken &t = tokens[numTokens];
+    t.type = type;
+    t.start = start;
+    t.len = 0;
+    t.skip = numTokens + 1;
+    return numTokens++;
+}
+
+void JSONReader::skipWhitespace(size_t &pos) const
+{
+    while (pos < jsonLen && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\r' || json[pos] == '\n'))
+        pos++;
+}
+
+bool JSONReader::parseValue(size_t &pos, uint8_t depth)
+{
+    if (pos >= jsonLen)
+        return false;
+
+    size_t start = pos;
+    char c = json[pos];
+    JSONType type;
+    switch (c) {
+    case '{':
+        type = JSON_OBJECT;
+        break;
+    case '[':
+        type = JSON_ARRAY;
+        break;
+    case '"':
+        type = JSON_STRING;
+        start++;
+        break;
+    case 't':
+        type = JSON_TRUE;
+        break;
+    case 'f':
+        type = JSON_FALSE;
+        break;
+    case 'n':
+        type = JSON_NULL;
+        break;
+    default:
+        type = JSON_NUMBER;
+        break;
+    }
+
+    int tok = addToken(type, start);
+    if (tok == -2)
+        return false;
+
+    bool ok;
+    switch (type) {
+    case JSON_OBJECT:
+    case JSON_ARRAY: {
+        if (depth >= JSONREADER_MAX_DEPTH)
+            return false;
+
+        char close = (type == JSON_OBJECT) ? '}' : ']';
+        pos++;
+        skipWhitespace(pos);
+        if (pos < jsonLen && json[pos] == close) {
+            pos++;
+            ok = true;
+            break;
+        }
+
+        ok = false;
+        while (pos < jsonLen) {
+            if (type == JSON_OBJECT) {
+                if (json[pos] != '"' || !parseValue(pos, depth + 1))
+                    return false;
+                skipWhitespace(pos);
+                if (pos >= jsonLen || json[pos] != ':')
+                    return false;
+                pos++;
+                skipWhitespace(pos);
+            }
+            if (!parseValue(pos, depth + 1))
+                return false;
+
+            skipWhitespace(pos);
+            if (pos >= jsonLen)
+                return false;
+            if (json[pos] == close) {
+                pos++;
+                ok = true;
+                break;
+            }
+            if (json[pos] != ',')
+                return false;
+            pos++;
+            skipWhitespace(pos);
+        }
+        break;
+    }
+    case JSON_STRING:
+        ok = parseString(pos);
+        break;
+    case JSON_TRUE:
+        ok = parseLiteral(pos, "true");
+        break;
+    case JSON_FALSE:
+        ok = parseLiteral(pos, "false");
+        break;
+    case JSON_NULL:
+        ok = parseLiteral(pos, "null");
+        break;
+    default:
+        ok = parseNumber(pos);
+        break;
+    }
+
+    if (ok && tok >= 0) {
+        JSONToken &t = tokens[tok];
+        t.len = ((type == JSON_STRING) ? pos - 1 : pos) - start;
+        t.skip = numTokens;
+    }
+    return ok;
+}
+
+bool JSONReader::parseString(size_t &pos)
+{
+    pos++; // opening quote
+    while (pos < jsonLen) {
+        unsigned char c = json[pos];
+        if (c == '"') {
+            pos++;
+            return true;
+        } else if (c == '\\') {
+            if (++pos >= jsonLen)
+                return false;
+            switch (json[pos]) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                break;
+            case 'u':
+                if (pos + 4 >= jsonLen)
+                    return false;
+                for (int i = 1; i <= 4; i++)
+                    if (!isxdigit((unsigned char)json[pos + i]))
+                        return false;
+                pos += 4;
+                break;
+            default:
+                return false;
+            }
+        } else if (c < ' ' && c != '\t') {
+            // Like JSON::Parse we tolerate raw tabs, real world senders produce them
+            return false;
+        }
+        pos++;
+    }
+
+    return false; // Unterminated
+}
+
+bool JSONReader::parseNumber(size_t &pos)
+{
+    if (pos < jsonLen && json[pos] == '-')
+        pos++;
+
+    // Integer part, no leading zeros allowed
+    if (pos >= jsonLen || !isdigit((unsigned char)json[pos]))
+        return false;
+    if (json[pos] == '0')
+        pos++;
+    else
+        while (pos < jsonLen && isdigit((unsigned char)json[pos]))
+            pos++;
+
+    if (pos < jsonLen && json[pos] == '.') {
+        pos++;
+        if (pos >= jsonLen || !isdigit((unsigned char)json[pos]))
+            return false;
+        while (pos < jsonLen && isdigit((unsigned char)json[pos]))
+            pos++;
+    }
+
+    if (pos < jsonLen && (json[pos] == 'e' || json[pos] == 'E')) {
+        pos++;
+        if (pos < jsonLen && (json[pos] == '+' || json[pos] == '-'))
+            pos++;
+        if (pos >= jsonLen || !isdigit((unsigned char)json[pos]))
+            return false;
+        while (pos < jsonLen && isdigit((unsigned char)json[pos]))
+            pos++;
+    }
+
+    return true;
+}
+
+bool JSONReader::parseLiteral(size_t &pos, const char *lit)
+{
+    size_t n = strlen(lit);
+    if (pos + n > jsonLen || memcmp(json + pos, lit, n) != 0)
+        return false;
+    pos += n;
+    return true;
+}
+
+uint8_t JSONReader::decodeChar(const char *&p, char out[4])
+{
+    if (*p != '\\') {
+        out[0] = *p++;
+        return 1;
+    }
+
+    p++;
+    switch (*p++) {
+    case 'b':
+        out[0] = '\b';
+        return 1;
+    case 'f':
+        out[0] = '\f';
+        return 1;
+    case 'n':
+        out[0] = '\n';
+        return 1;
+    case 'r':
+        out[0] = '\r';
+        return 1;
+    case 't':
+        out[0] = '\t';
+        return 1;
+    case 'u': {
+        uint16_t cp = 0;
+        for (int i = 0; i < 4; i++) {
+            char h = *p++;
+            cp = (cp << 4) | (h <= '9' ? h - '0' : (h | 0x20) - 'a' + 10);
+        }
+        // Encode as UTF-8 (surrogate pairs are passed through as two 3 byte sequences)
+        if (cp < 0x80) {
+            out[0] = cp;
+            return 1;
+        } else if (cp < 0x800) {
+            out[0] = 0xc0 | (cp >> 6);
+            out[1] = 0x80 | (cp & 0x3f);
+            return 2;
+        } else {
+            out[0] = 0xe0 | (cp >> 12);
+            out[1] = 0x80 | ((cp >> 6) & 0x3f);
+            out[2] = 0x80 | (cp & 0x3f);
+            return 3;
+        }
+    }
+    default: // '"', '\\' and '/' stand for themselves
+        out[0] = p[-1];
+        return 1;
+    }
+}
+
+int JSONReader::find(int obj, const char *key) const
+{
+    if (type(obj) != JSON_OBJECT)
+        return -1;
+
+    for (int i = obj + 1; i < tokens[obj].skip; i = tokens[i + 1].skip)
+        if (stringEquals(i, key))
+            return i + 1;
+
+    return -1;
+}
+
+bool JSONReader::stringEquals(int i, const char *s) const
+{
+    if (type(i) != JSON_STRING)
+        return false;
+
+    const char *p = json + tokens[i].start;
+    const char *end = p + tokens[i].len;
+
+    // Fast path, nothing escaped
+    if (!memchr(p, '\\', tokens[i].len))
+        return strlen(s) == tokens[i].len && memcmp(p, s, tokens[i].len) == 0;
+
+    char c[4];
+    while (p < end) {
+        uint8_t n = decodeChar(p, c);
+        if (!*s || strncmp(s, c, n) != 0)
+            return false;
+        s += n;
+    }
+    return *s == 0;
+}
+
+int JSONReader::getString(int i, char *out, size_t outSize) const
+{
+    if (type(i) != JSON_STRING)
+        return -1;
+
+    const char *p = json + tokens[i].start;
+    const char *end = p + tokens[i].len;
+    size_t n = 0;
+    char c[4];
+    while (p < end) {
+        uint8_t cn = decodeChar(p, c);
+        if (n + cn > outSize)
+            return -1;
+        memcpy(out + n, c, cn);
+        n += cn;
+    }
+    return n;
+}
+
+double JSONReader::getNumber(int i) const
+{
+    if (type(i) != JSON_NUMBER)
+        return 0;
+
+    // The input isn't NUL terminated, so give strtod its own copy
+    char num[32];
+    size_t n = tokens[i].len;
+    if (n >= sizeof(num))
+        n = sizeof(num) - 1;
+    memcpy(num, json + tokens[i].start, n);
+    num[n] = 0;
+    return strtod(num, NULL);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+
+/// Deepest object/array nesting JSONReader accepts
+#define JSONREADER_MAX_DEPTH 16
+
+enum JSONType : uint8_t { JSON_NONE, JSON_OBJECT, JSON_ARRAY, JSON_STRING, JSON_NUMBER, JSON_TRUE, JSON_FALSE, JSON_NULL };
+
+/**
+ * One value found by JSONReader.  Tokens are stored in document order, so the children of an object or array directly
+ * follow it (for objects alternating key, value) and skip is the index of the first token after the whole subtree.
+ */
+struct JSONToken {
+    uint16_t start; // offset of the first char (for strings, the char after the opening quote)
+    uint16_t len;   // raw length (for strings, excluding quotes and still escaped)
+    uint16_t skip;
+    JSONType type;
+};
+
+/**
+ * A validating JSON parser which works in place over the caller's buffer.  Unlike JSON::Parse it allocates nothing and
+ * never copies keys or values: parse() just records where each value lives in a caller provided token array, and strings
+ * are only unescaped when (and where) the caller asks for them.
+ *
+ * The input does not need to be NUL terminated.
+ *
+ *     JSONToken tokens[16];
+ *     JSONReader json(buf, len, tokens, 16);
+ *     if (json.parse() && json.type(0) == JSON_OBJECT) {
+ *         int t = json.find(0, "type");
+ *         if (json.stringEquals(t, "sendtext")) ...
+ *     }
+ */
+class JSONReader
+{
+    const char *json;
+    size_t jsonLen;
+
+    JSONToken *tokens;
+    uint16_t maxTokens;
+    uint16_t numTokens = 0;
+
+  public:
+    JSONReader(const char *_json, size_t _jsonLen, JSONToken *_tokens, uint16_t _maxTokens)
+        : json(_json), jsonLen(_jsonLen), tokens(_tokens), maxTokens(_maxTokens)
+    {
+    }
+
+    /// Tokenize the document, returns false if it is not valid JSON or has more than maxTokens values
+    bool parse();
+
+    /// Cheap check that buf holds exactly one valid JSON value (plus whitespace), nothing is stored or allocated
+    static bool isJSON(const char *buf, size_t len);
+
+    /// Number of tokens found by parse, token 0 is the root value
+    uint16_t size() const { return numTokens; }
+
+    /// The type of token i, JSON_NONE if i is out of range (so the result of a failed find can be passed straight in)
+    JSONType type(int i) const { return valid(i) ? tokens[i].type : JSON_NONE; }
+
+    /// Find key in the object at token obj, returns the token index of its value or -1
+    int find(int obj, const char *key) const;
+
+    /// true if token i is a string whose unescaped value is s
+    bool stringEquals(int i, const char *s) const;
+
+    /**
+     * Unescape the string at token i into out (not NUL terminated).
+     * @return the number of bytes written, or -1 if token i is not a string or doesn't fit in outSize
+     */
+    int getString(int i, char *out, size_t outSize) const;
+
+    /// The value of the number at token i, 0 if i is missing or not a number
+    double getNumber(int i) const;
+
+  private:
+    bool valid(int i) const { return i >= 0 && i < numTokens; }
+
+    /// Add a token (if we are storing them), returns its index, -1 if we are only validating, or -2 if we ran out
+    int addToken(JSONType type, size_t start);
+
+    bool parseValue(size_t &pos, uint8_t depth);
+    bool parseString(size_t &pos);
+    bool parseNumber(size_t &pos);
+    bool parseLiteral(size_t &pos, const char *lit);
+    void skipWhitespace(size_t &pos) const;
+
+    /// Decode the string char at p (which must be inside a valid string), returns the UTF-8 bytes written to out
+    static uint8_t decodeChar(const char *&p, char out[4]);
+};
@@ -0,0 +1,200 @@
+#include "JSONWriter.h"
+#include <math.h>
+#include <stdio.h>
+
+JSONWriter::JSONWriter(char *_buf, size_t _bufSize) : buf(_buf), bufSize(_bufSize)
+{
+    if (bufSize)
+        buf[0] = 0;
+}
+
+void JSONWriter::write(const char *s, size_t n)
+{
+    if (out) {
+        out->write((const uint8_t *)s, n);
+        len += n;
+        return;
+    }
+
+    if (overflow)
+        return;
+
+    // Always leave room for the terminating NUL
+    if (len + n >= bufSize) {
+        overflow = true;
+        return;
+    }
+    memcpy(buf + len, s, n);
+    len += n;
+    buf[len] = 0;
+}
+
+void JSONWriter::separator()
+{
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+
+    uint32_t bit = 1UL << depth;
+    if (hasElement & bit)
+        write(',');
+    hasElement |= bit;
+}
+
+void JSONWriter::beginObject()
+{
+    separator();
+    write('{');
+    if (depth < JSONWRITER_MAX_DEPTH - 1)
+        depth++;
+    hasElement &= ~(1UL << depth);
+}
+
+void JSONWriter::endObject()
+{
+    if (depth)
+        depth--;
+    write('}');
+}
+
+void JSONWriter::beginArray()
+{
+    separator();
+    write('[');
+    if (depth < JSONWRITER_MAX_DEPTH - 1)
+        depth++;
+    hasElement &= ~(1UL << depth);
+}
+
+void JSONWriter::endArray()
+{
+    if (depth)
+        depth--;
+    write(']');
+}
+
+void JSONWriter::key(const char *name)
+{
+    separator();
+    writeEscaped(name, strlen(name));
+    write(':');
+    afterKey = true;
+}
+
+void JSONWriter::writeEscaped(const char *s, size_t n)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    write('"');
+    // Copy runs of characters which need no escaping in one go
+    size_t runStart = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = s[i];
+        const char *esc = NULL;
+        char uesc[7];
+
+        switch (c) {
+        case '"':
+            esc = "\\\"";
+            break;
+        case '\\':
+            esc = "\\\\";
+            break;
+        case '/':
+            esc = "\\/";
+            break;
+        case '\b':
+            esc = "\\b";
+            break;
+        case '\f':
+            esc = "\\f";
+            break;
+        case '\n':
+            esc = "\\n";
+            break;
+        case '\r':
+            esc = "\\r";
+            break;
+        case '\t':
+            esc = "\\t";
+            break;
+        default:
+            if (c < ' ' || c == 0x7f) {
+                uesc[0] = '\\';
+                uesc[1] = 'u';
+                uesc[2] = '0';
+                uesc[3] = '0';
+                uesc[4] = hex[c >> 4];
+                uesc[5] = hex[c & 0xf];
+                uesc[6] = 0;
+                esc = uesc;
+            }
+            // UTF-8 sequences are valid inside JSON strings, pass them through as is
+            break;
+        }
+
+        if (esc) {
+            write(s + runStart, i - runStart);
+            write(esc);
+            runStart = i + 1;
+        }
+    }
+    write(s + runStart, n - runStart);
+    write('"');
+}
+
+void JSONWriter::value(const char *s)
+{
+    value(s, strlen(s));
+}
+
+void JSONWriter::value(const char *s, size_t n)
+{
+    separator();
+    writeEscaped(s, n);
+}
+
+void JSONWriter::value(long v)
+{
+    char num[24];
+    separator();
+    write(num, snprintf(num, sizeof(num), "%ld", v));
+}
+
+void JSONWriter::value(unsigned long v)
+{
+    char num[24];
+    separator();
+    write(num, snprintf(num, sizeof(num), "%lu", v));
+}
+
+void JSONWriter::value(double v)
+{
+    separator();
+    if (isinf(v) || isnan(v)) {
+        write("null");
+        return;
+    }
+
+    char num[32];
+    write(num, snprintf(num, sizeof(num), "%.15g", v));
+}
+
+void JSONWriter::value(bool v)
+{
+    separator();
+    write(v ? "true" : "false");
+}
+
+void JSONWriter::valueNull()
+{
+    separator();
+    write("null");
+}
+
+void JSONWriter::raw(const char *json, size_t n)
+{
+    separator();
+    write(json, n);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Arduino.h>
+
+/// Deepest object/array nesting JSONWriter supports
+#define JSONWRITER_MAX_DEPTH 32
+
+/**
+ * A streaming JSON serializer.  Nothing is allocated and no document tree is built: output goes
+ * straight into a caller provided buffer or to any Arduino Print (an HTTPResponse, a client socket...).
+ *
+ * Commas and key/value separators are inserted automatically, callers just describe the document in order:
+ *
+ *     JSONWriter w(buf, sizeof(buf));
+ *     w.beginObject();
+ *     w.key("id");
+ *     w.value(mp->id);
+ *     w.endObject();
+ *     if (w.overflowed()) ...
+ */
+class JSONWriter
+{
+    Print *out = NULL;
+
+    char *buf = NULL;
+    size_t bufSize = 0;
+
+    size_t len = 0;
+    bool overflow = false;
+
+    /// bit n set means we have already written an element at nesting level n (so the next one needs a comma)
+    uint32_t hasElement = 0;
+    uint8_t depth = 0;
+
+    /// true if we just wrote a key, so the next value must not be preceded by a comma
+    bool afterKey = false;
+
+  public:
+    /// Serialize into buf, which is always kept NUL terminated
+    JSONWriter(char *_buf, size_t _bufSize);
+
+    /// Serialize directly to a stream
+    explicit JSONWriter(Print *_out) : out(_out) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    /// Name the next value inside an object
+    void key(const char *name);
+
+    void value(const char *s);
+    void value(const char *s, size_t n);
+    // Overloaded on the fundamental types (not intN_t) so every integer type resolves on every platform
+    void value(int v) { value((long)v); }
+    void value(unsigned int v) { value((unsigned long)v); }
+    void value(long v);
+    void value(unsigned long v);
+    void value(double v);
+    void value(bool v);
+    void valueNull();
+
+    /// Insert already serialized JSON (the caller is responsible for it being valid)
+    void raw(const char *json, size_t n);
+
+    /// Shorthands for key(name) followed by value(v)
+    template <typename T> void field(const char *name, T v)
+    {
+        key(name);
+        value(v);
+    }
+
+    /// Bytes written so far
+    size_t length() const { return len; }
+
+    /// true if the output buffer was too small (the output is truncated and not valid JSON)
+    bool overflowed() const { return overflow; }
+
+  private:
+    /// Emit a comma if needed before a new element at the current depth
+    void separator();
+
+    void write(const char *s, size_t n);
+    void write(const char *s) { write(s, strlen(s)); }
+    void write(char c) { write(&c, 1); }
+
+    void writeEscaped(const char *s, size_t n);
+};
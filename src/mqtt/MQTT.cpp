@@ -13,7 +13,8 @@
 #include <WiFi.h>
 #endif
 #include <assert.h>
-#include "mqtt/JSON.h"
+#include "mqtt/JSONReader.h"
+#include "mqtt/JSONWriter.h"
 
 MQTT *mqtt;
 
@@ -21,9 +22,8 @@ String statusTopic = "msh/2/stat/";
 String cryptTopic = "msh/2/c/";   // msh/2/c/CHANNELID/NODEID
 String jsonTopic = "msh/2/json/"; // msh/2/json/CHANNELID/NODEID
 
-static MemoryDynamic<ServiceEnvelope> staticMqttPool;
-
-Allocator<ServiceEnvelope> &mqttPool = staticMqttPool;
+/// Scratch buffer the JSON uplink messages are serialized into (they must fit in the PubSubClient buffer anyway)
+static char jsonBuf[MQTT_JSON_BUF_SIZE];
 
 void MQTT::mqttCallback(char *topic, byte *payload, unsigned int length)
 {
@@ -37,17 +37,12 @@ void MQTT::onPublish(char *topic, byte *payload, unsigned int length)
 
     if (moduleConfig.mqtt.json_enabled && (strncmp(topic, jsonTopic.c_str(), jsonTopic.length()) == 0)) {
         // check if this is a json payload message by comparing the topic start
-        char payloadStr[length + 1];
-        memcpy(payloadStr, payload, length);
-        payloadStr[length] = 0; // null terminated string
-        JSONValue *json_value = JSON::Parse(payloadStr);
-        if (json_value != NULL) {
+        // the envelope is tokenized in place, nothing is copied until we build the MeshPacket
+        JSONToken tokens[MQTT_JSON_MAX_TOKENS];
+        JSONReader json((const char *)payload, length, tokens, MQTT_JSON_MAX_TOKENS);
+        if (json.parse()) {
             LOG_INFO("JSON Received on MQTT, parsing..\n");
 
-            // check if it is a valid envelope
-            JSONObject json;
-            json = json_value->AsObject();
-
             // parse the channel name from the topic string
             char *ptr = strtok(topic, "/");
             for (int i = 0; i < 3; i++) {
@@ -57,41 +52,45 @@ void MQTT::onPublish(char *topic, byte *payload, unsigned int length)
             Channel sendChannel = channels.getByName(ptr);
             LOG_DEBUG("Found Channel name: %s (Index %d)\n", channels.getGlobalId(sendChannel.settings.channel_num), sendChannel.settings.channel_num);
 
-            if ((json.find("sender") != json.end()) && (json.find("payload") != json.end()) && (json.find("type") != json.end()) && json["type"]->IsString() && (json["type"]->AsString().compare("sendtext") == 0)) {
-                // this is a valid envelope
-                if (json["payload"]->IsString() && json["type"]->IsString() && (json["sender"]->AsString().compare(owner.id) != 0)) {
-                    std::string jsonPayloadStr = json["payload"]->AsString();
-                    LOG_INFO("JSON payload %s, length %u\n", jsonPayloadStr.c_str(), jsonPayloadStr.length());
+            // check if it is a valid envelope (find returns -1 if the root isn't an object)
+            int sender = json.find(0, "sender");
+            int jsonPayload = json.find(0, "payload");
+            int type = json.find(0, "type");
 
+            if ((sender >= 0) && (jsonPayload >= 0) && json.stringEquals(type, "sendtext")) {
+                // this is a valid envelope
+                if (json.type(jsonPayload) == JSON_STRING && !json.stringEquals(sender, owner.id)) {
                     // construct protobuf data packet using TEXT_MESSAGE, send it to the mesh
                     MeshPacket *p = router->allocForSending();
                     p->decoded.portnum = PortNum_TEXT_MESSAGE_APP;
                     p->channel = sendChannel.settings.channel_num;
                     if (sendChannel.settings.downlink_enabled) {
-                        if (jsonPayloadStr.length() <= sizeof(p->decoded.payload.bytes)) {
-                            memcpy(p->decoded.payload.bytes, jsonPayloadStr.c_str(), jsonPayloadStr.length());
-                            p->decoded.payload.size = jsonPayloadStr.length();
-                            MeshPacket *packet = packetPool.allocCopy(*p);
-                            service.sendToMesh(packet, RX_SRC_LOCAL);
+                        // unescape straight into the packet
+                        int len = json.getString(jsonPayload, (char *)p->decoded.payload.bytes, sizeof(p->decoded.payload.bytes));
+                        if (len >= 0) {
+                            p->decoded.payload.size = len;
+                            LOG_INFO("JSON payload %.*s, length %u\n", len, p->decoded.payload.bytes, len);
+                            service.sendToMesh(p, RX_SRC_LOCAL);
                         } else {
                             LOG_WARN("Received MQTT json payload too long, dropping\n");
+                            packetPool.release(p);
                         }
                     } else {
                         LOG_WARN("Received MQTT json payload on channel %s, but downlink is disabled, dropping\n", sendChannel.settings.name);
+                        packetPool.release(p);
                     }
                 } else {
                     LOG_DEBUG("JSON Ignoring downlink message we originally sent.\n");
                 }
-            } else if ((json.find("sender") != json.end()) && (json.find("payload") != json.end()) && (json.find("type") != json.end()) && json["type"]->IsString() && (json["type"]->AsString().compare("sendposition") == 0)) {
+            } else if ((sender >= 0) && (jsonPayload >= 0) && json.stringEquals(type, "sendposition")) {
                 //invent the "sendposition" type for a valid envelope
-                if (json["payload"]->IsObject() && json["type"]->IsString() && (json["sender"]->AsString().compare(owner.id) != 0)) {
-                    JSONObject posit;
-                    posit = json["payload"]->AsObject(); //get nested JSON Position
+                if (json.type(jsonPayload) == JSON_OBJECT && !json.stringEquals(sender, owner.id)) {
+                    // get nested JSON Position, missing fields read as 0
                     Position pos = Position_init_default;
-                    pos.latitude_i = posit["latitude_i"]->AsNumber();
-                    pos.longitude_i = posit["longitude_i"]->AsNumber();
-                    pos.altitude = posit["altitude"]->AsNumber();
-                    pos.time = posit["time"]->AsNumber();
+                    pos.latitude_i = json.getNumber(json.find(jsonPayload, "latitude_i"));
+                    pos.longitude_i = json.getNumber(json.find(jsonPayload, "longitude_i"));
+                    pos.altitude = json.getNumber(json.find(jsonPayload, "altitude"));
+                    pos.time = json.getNumber(json.find(jsonPayload, "time"));
 
                     // construct protobuf data packet using POSITION, send it to the mesh
                     MeshPacket *p = router->allocForSending();
@@ -102,6 +101,7 @@ void MQTT::onPublish(char *topic, byte *payload, unsigned int length)
                         service.sendToMesh(p, RX_SRC_LOCAL);
                     } else {
                         LOG_WARN("Received MQTT json payload on channel %s, but downlink is disabled, dropping\n", sendChannel.settings.name);
+                        packetPool.release(p);
                     }
                 } else {
                     LOG_DEBUG("JSON Ignoring downlink message we originally sent.\n");
@@ -113,7 +113,6 @@ void MQTT::onPublish(char *topic, byte *payload, unsigned int length)
             // no json, this is an invalid payload
             LOG_ERROR("Invalid MQTT service envelope, topic %s, len %u!\n", topic, length);
         }
-        delete json_value;
     } else {
         if (!pb_decode_from_bytes(payload, length, &ServiceEnvelope_msg, &e)) {
             LOG_ERROR("Invalid MQTT service envelope, topic %s, len %u!\n", topic, length);
@@ -124,13 +123,16 @@ void MQTT::onPublish(char *topic, byte *payload, unsigned int length)
             else {
                 if (e.packet) {
                     LOG_INFO("Received MQTT topic %s, len=%u\n", topic, length);
-                    MeshPacket *p = packetPool.allocCopy(*e.packet);
 
-                    // ignore messages sent by us or if we don't have the channel key
-                    if (router && p->from != nodeDB.getNodeNum() && perhapsDecode(p))
-                        router->enqueueReceivedMessage(p);
-                    else
-                        packetPool.release(p);
+                    // ignore messages sent by us and anything that couldn't have come over LoRa
+                    MeshPacket *mp = e.packet;
+                    bool valid = (mp->which_payload_variant == MeshPacket_encrypted_tag ||
+                                  mp->which_payload_variant == MeshPacket_decoded_tag) &&
+                                 mp->from != 0 && mp->hop_limit <= HOP_MAX;
+                    if (!valid)
+                        LOG_WARN("Ignoring invalid MQTT packet from 0x%x\n", mp->from);
+                    else if (router && mp->from != nodeDB.getNodeNum())
+                        router->enqueueReceivedMqttMessage(packetPool.allocCopy(*mp));
                 }
             }
         }
@@ -146,13 +148,18 @@ void mqttInit()
     new MQTT();
 }
 
-MQTT::MQTT() : concurrency::OSThread("mqtt"), pubSub(mqttClient), mqttQueue(MAX_MQTT_QUEUE)
+MQTT::MQTT() : concurrency::OSThread("mqtt"), pubSub(mqttClient)
 {
     if(moduleConfig.mqtt.enabled) {
 
         assert(!mqtt);
         mqtt = this;
 
+        // Most of the time the broker keeps up and this is all we need, growUplinkQueue() takes PSRAM only once it doesn't
+        uplinkQueue = static_cast<MQTTUplinkEntry *>(calloc(MAX_MQTT_QUEUE, sizeof(MQTTUplinkEntry)));
+        assert(uplinkQueue);
+        uplinkCapacity = MAX_MQTT_QUEUE;
+
         pubSub.setCallback(mqttCallback);
 
         // preflightSleepObserver.observe(&preflightSleep);
@@ -200,6 +207,7 @@ void MQTT::reconnect()
             enabled = true; // Start running background process again
             runASAP = true;
             reconnectCount = 0;
+            memset(topics, 0, sizeof(topics)); // our node id might have changed since we cached them
 
             /// FIXME, include more information in the status text
             bool ok = pubSub.publish(myStatus.c_str(), "online", true);
@@ -277,31 +285,10 @@ int32_t MQTT::runOnce()
         if (wantConnection) {
             reconnect();
 
-            // If we succeeded, empty the queue one by one and start reading rapidly, else try again in 30 seconds (TCP connections are EXPENSIVE so try rarely)
+            // If we succeeded, start draining the queue and reading rapidly, else try again in 30 seconds (TCP connections are EXPENSIVE so try rarely)
             if (pubSub.connected()) {
-                if (!mqttQueue.isEmpty()) {
-                    // FIXME - this size calculation is super sloppy, but it will go away once we dynamically alloc meshpackets
-                    ServiceEnvelope *env = mqttQueue.dequeuePtr(0);
-                    static uint8_t bytes[MeshPacket_size + 64];
-                    size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &ServiceEnvelope_msg, env);
-
-                    String topic = cryptTopic + env->channel_id + "/" + owner.id;
-                    LOG_INFO("publish %s, %u bytes from queue\n", topic.c_str(), numBytes);
-
-                    pubSub.publish(topic.c_str(), bytes, numBytes, false);
-
-                    if (moduleConfig.mqtt.json_enabled) {
-                        // handle json topic
-                        auto jsonString = this->downstreamPacketToJson(env->packet);
-                        if (jsonString.length() != 0) {
-                            String topicJson = jsonTopic + env->channel_id + "/" + owner.id;
-                            LOG_INFO("JSON publish message to %s, %u bytes: %s\n", topicJson.c_str(), jsonString.length(), jsonString.c_str());
-                            pubSub.publish(topicJson.c_str(), jsonString.c_str(), false);
-                        }
-                    }
-                    mqttPool.release(env);
-                }
-                return 200;
+                drainUplink();
+                return uplinkCount ? 20 : 200;
             } else {
                 return 30000;
             }
@@ -312,6 +299,14 @@ int32_t MQTT::runOnce()
         if (!wantConnection) {
             LOG_INFO("MQTT link not needed, dropping\n");
             pubSub.disconnect();
+        } else {
+            // keep working through any backlog from while we were offline
+            drainUplink();
+
+            if (millis() - lastStatsMsec >= MQTT_STATS_INTERVAL_MSEC) {
+                lastStatsMsec = millis();
+                logStats();
+            }
         }
 
         powerFSM.trigger(EVENT_CONTACT_FROM_PHONE); // Suppress entering light sleep (because that would turn off bluetooth)
@@ -324,79 +319,182 @@ void MQTT::onSend(const MeshPacket &mp, ChannelIndex chIndex)
     auto &ch = channels.getByIndex(chIndex);
 
     if (ch.settings.uplink_enabled) {
-        const char *channelId = channels.getGlobalId(chIndex); // FIXME, for now we just use the human name for the channel
+        // publish right away if we can, but never overtake packets that are already waiting
+        if (pubSub.connected() && uplinkCount == 0) {
+            if (publishPacket(mp, chIndex)) {
+                stats.published++;
+                return;
+            }
+            stats.publishFailed++;
+        } else if (!pubSub.connected()) {
+            LOG_INFO("MQTT not connected, queueing packet\n");
+        }
 
-        ServiceEnvelope *env = mqttPool.allocZeroed();
-        env->channel_id = (char *)channelId;
-        env->gateway_id = owner.id;
-        env->packet = (MeshPacket *)&mp;
+        enqueueUplink(mp, chIndex);
+    }
+}
 
-        // don't bother sending if not connected...
-        if (pubSub.connected()) {
+void MQTT::enqueueUplink(const MeshPacket &mp, ChannelIndex chIndex)
+{
+    if (uplinkCount == uplinkCapacity && !growUplinkQueue()) {
+        LOG_WARN("NOTE: MQTT queue is full, discarding oldest\n");
+        uplinkHead = (uplinkHead + 1) % uplinkCapacity;
+        uplinkCount--;
+        stats.dropped++;
+    }
 
-            // FIXME - this size calculation is super sloppy, but it will go away once we dynamically alloc meshpackets
-            static uint8_t bytes[MeshPacket_size + 64];
-            size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &ServiceEnvelope_msg, env);
+    MQTTUplinkEntry &e = uplinkQueue[(uplinkHead + uplinkCount) % uplinkCapacity];
+    e.packet = mp;
+    e.chIndex = chIndex;
+    e.queuedAtMsec = millis();
+    uplinkCount++;
 
-            String topic = cryptTopic + channelId + "/" + owner.id;
-            LOG_DEBUG("publish %s, %u bytes\n", topic.c_str(), numBytes);
+    stats.queued++;
+    if (uplinkCount > stats.maxQueueDepth)
+        stats.maxQueueDepth = uplinkCount;
+}
 
-            pubSub.publish(topic.c_str(), bytes, numBytes, false);
+bool MQTT::growUplinkQueue()
+{
+#ifdef ARCH_ESP32
+    if (uplinkGrowTried || !psramFound())
+        return false;
+    uplinkGrowTried = true;
+
+    uint32_t capacity = ESP.getFreePsram() / MQTT_QUEUE_PSRAM_SHARE / sizeof(MQTTUplinkEntry);
+    if (capacity > MAX_MQTT_QUEUE_PSRAM)
+        capacity = MAX_MQTT_QUEUE_PSRAM;
+    MQTTUplinkEntry *bigger = NULL;
+    if (capacity > uplinkCapacity)
+        bigger = static_cast<MQTTUplinkEntry *>(ps_calloc(capacity, sizeof(MQTTUplinkEntry)));
+    if (!bigger) {
+        LOG_WARN("Can't move the MQTT uplink queue to PSRAM\n");
+        return false;
+    }
 
-            if (moduleConfig.mqtt.json_enabled) {
-                // handle json topic
-                auto jsonString = this->downstreamPacketToJson((MeshPacket *)&mp);
-                if (jsonString.length() != 0) {
-                    String topicJson = jsonTopic + channelId + "/" + owner.id;
-                    LOG_INFO("JSON publish message to %s, %u bytes: %s\n", topicJson.c_str(), jsonString.length(), jsonString.c_str());
-                    pubSub.publish(topicJson.c_str(), jsonString.c_str(), false);
-                }
-            }
-        } else {
-            LOG_INFO("MQTT not connected, queueing packet\n");
-            if (mqttQueue.numFree() == 0) {
-                LOG_WARN("NOTE: MQTT queue is full, discarding oldest\n");
-                ServiceEnvelope *d = mqttQueue.dequeuePtr(0);
-                if (d)
-                    mqttPool.release(d);
-            }
-            // make a copy of serviceEnvelope and queue it
-            ServiceEnvelope *copied = mqttPool.allocCopy(*env);
-            assert(mqttQueue.enqueue(copied, 0));
+    for (uint16_t i = 0; i < uplinkCount; i++)
+        bigger[i] = uplinkQueue[(uplinkHead + i) % uplinkCapacity];
+    free(uplinkQueue);
+    uplinkQueue = bigger;
+    uplinkCapacity = capacity;
+    uplinkHead = 0;
+    LOG_INFO("MQTT uplink queue moved to PSRAM, now holds %u packets\n", uplinkCapacity);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MQTT::drainUplink()
+{
+    if (!uplinkCount)
+        return;
+
+    size_t budget = MQTT_UPLINK_BYTES_PER_TICK;
+    uint16_t before = uplinkCount;
+    while (uplinkCount && pubSub.connected()) {
+        MQTTUplinkEntry &e = uplinkQueue[uplinkHead];
+        size_t numBytes = publishPacket(e.packet, e.chIndex);
+        if (!numBytes) {
+            // the client can't take more right now, leave the packet at the head and retry next pass
+            stats.publishFailed++;
+            break;
         }
-        mqttPool.release(env);
+
+        uint32_t latency = millis() - e.queuedAtMsec;
+        if (latency > stats.maxLatencyMsec)
+            stats.maxLatencyMsec = latency;
+        stats.avgLatencyMsec = stats.avgLatencyMsec ? (stats.avgLatencyMsec * 7 + latency) / 8 : latency;
+        stats.published++;
+
+        uplinkHead = (uplinkHead + 1) % uplinkCapacity;
+        uplinkCount--;
+
+        if (numBytes >= budget)
+            break;
+        budget -= numBytes;
+    }
+
+    if (before != uplinkCount)
+        LOG_DEBUG("MQTT published %u queued packets, %u left\n", before - uplinkCount, uplinkCount);
+}
+
+size_t MQTT::publishPacket(const MeshPacket &mp, ChannelIndex chIndex)
+{
+    const ChannelTopics &t = getTopics(chIndex);
+
+    ServiceEnvelope env = ServiceEnvelope_init_default;
+    env.channel_id = (char *)t.channelId;
+    env.gateway_id = owner.id;
+    env.packet = (MeshPacket *)&mp;
+
+    // FIXME - this size calculation is super sloppy, but it will go away once we dynamically alloc meshpackets
+    static uint8_t bytes[MeshPacket_size + 64];
+    size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &ServiceEnvelope_msg, &env);
+
+    LOG_DEBUG("publish %s, %u bytes\n", t.crypt, numBytes);
+    if (!pubSub.publish(t.crypt, bytes, numBytes, false))
+        return 0;
+
+    if (moduleConfig.mqtt.json_enabled) {
+        // handle json topic
+        JSONWriter w(jsonBuf, sizeof(jsonBuf));
+        if (this->downstreamPacketToJson((MeshPacket *)&mp, w)) {
+            LOG_INFO("JSON publish message to %s, %u bytes: %s\n", t.json, w.length(), jsonBuf);
+            if (pubSub.publish(t.json, (const uint8_t *)jsonBuf, w.length(), false))
+                numBytes += w.length();
+        }
+    }
+
+    return numBytes;
+}
+
+const MQTT::ChannelTopics &MQTT::getTopics(ChannelIndex chIndex)
+{
+    ChannelTopics &t = topics[chIndex];
+    const char *channelId = channels.getGlobalId(chIndex); // FIXME, for now we just use the human name for the channel
+
+    if (strcmp(t.channelId, channelId) != 0 || !*t.crypt) {
+        strncpy(t.channelId, channelId, sizeof(t.channelId) - 1);
+        snprintf(t.crypt, sizeof(t.crypt), "%s%s/%s", cryptTopic.c_str(), t.channelId, owner.id);
+        snprintf(t.json, sizeof(t.json), "%s%s/%s", jsonTopic.c_str(), t.channelId, owner.id);
     }
+    return t;
 }
 
-// converts a downstream packet into a json message
-std::string MQTT::downstreamPacketToJson(MeshPacket *mp)
+void MQTT::logStats()
 {
-    // the created jsonObj is immutable after creation, so
-    // we need to do the heavy lifting before assembling it.
-    String msgType;
-    JSONObject msgPayload;
-    JSONObject jsonObj;
+    LOG_INFO("MQTT uplink: published=%u queued=%u dropped=%u failed=%u, queue %u/%u (max %u), latency avg=%ums max=%ums\n",
+             stats.published, stats.queued, stats.dropped, stats.publishFailed, uplinkCount, uplinkCapacity, stats.maxQueueDepth,
+             stats.avgLatencyMsec, stats.maxLatencyMsec);
+}
+
+// converts a downstream packet into a json message, serialized straight into the writer (no intermediate tree)
+bool MQTT::downstreamPacketToJson(MeshPacket *mp, JSONWriter &w)
+{
+    const char *msgType = "";
+
+    w.beginObject();
 
     switch (mp->decoded.portnum) {
     case PortNum_TEXT_MESSAGE_APP: {
         msgType = "text";
-        // convert bytes to string
         LOG_DEBUG("got text message of size %u\n", mp->decoded.payload.size);
-        char payloadStr[(mp->decoded.payload.size) + 1];
-        memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
-        payloadStr[mp->decoded.payload.size] = 0; // null terminated string
-        // check if this is a JSON payload
-        JSONValue *json_value = JSON::Parse(payloadStr);
-        if (json_value != NULL) {
+        const char *payloadStr = (const char *)mp->decoded.payload.bytes;
+        w.key("payload");
+        // check if this is a JSON payload (just a validating scan, nothing is built)
+        if (JSONReader::isJSON(payloadStr, mp->decoded.payload.size)) {
             LOG_INFO("text message payload is of type json\n");
-            // if it is, then we can just use the json object
-            jsonObj["payload"] = json_value;
+            // if it is, then we can just use the json text as is
+            w.raw(payloadStr, mp->decoded.payload.size);
         } else {
             // if it isn't, then we need to create a json object
             // with the string as the value
             LOG_INFO("text message payload is of type plaintext\n");
-            msgPayload["text"] = new JSONValue(payloadStr);
-            jsonObj["payload"] = new JSONValue(msgPayload);
+            w.beginObject();
+            w.key("text");
+            w.value(payloadStr, mp->decoded.payload.size);
+            w.endObject();
         }
         break;
     }
@@ -408,20 +506,22 @@ std::string MQTT::downstreamPacketToJson(MeshPacket *mp)
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &Telemetry_msg, &scratch)) {
                 decoded = &scratch;
+                w.key("payload");
+                w.beginObject();
                 if (decoded->which_variant == Telemetry_device_metrics_tag) {
-                    msgPayload["battery_level"] = new JSONValue((int)decoded->variant.device_metrics.battery_level);
-                    msgPayload["voltage"] = new JSONValue(decoded->variant.device_metrics.voltage);
-                    msgPayload["channel_utilization"] = new JSONValue(decoded->variant.device_metrics.channel_utilization);
-                    msgPayload["air_util_tx"] = new JSONValue(decoded->variant.device_metrics.air_util_tx);
+                    w.field("battery_level", (int)decoded->variant.device_metrics.battery_level);
+                    w.field("voltage", decoded->variant.device_metrics.voltage);
+                    w.field("channel_utilization", decoded->variant.device_metrics.channel_utilization);
+                    w.field("air_util_tx", decoded->variant.device_metrics.air_util_tx);
                 } else if (decoded->which_variant == Telemetry_environment_metrics_tag) {
-                    msgPayload["temperature"] = new JSONValue(decoded->variant.environment_metrics.temperature);
-                    msgPayload["relative_humidity"] = new JSONValue(decoded->variant.environment_metrics.relative_humidity);
-                    msgPayload["barometric_pressure"] = new JSONValue(decoded->variant.environment_metrics.barometric_pressure);
-                    msgPayload["gas_resistance"] = new JSONValue(decoded->variant.environment_metrics.gas_resistance);
-                    msgPayload["voltage"] = new JSONValue(decoded->variant.environment_metrics.voltage);
-                    msgPayload["current"] = new JSONValue(decoded->variant.environment_metrics.current);
+                    w.field("temperature", decoded->variant.environment_metrics.temperature);
+                    w.field("relative_humidity", decoded->variant.environment_metrics.relative_humidity);
+                    w.field("barometric_pressure", decoded->variant.environment_metrics.barometric_pressure);
+                    w.field("gas_resistance", decoded->variant.environment_metrics.gas_resistance);
+                    w.field("voltage", decoded->variant.environment_metrics.voltage);
+                    w.field("current", decoded->variant.environment_metrics.current);
                 }
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.endObject();
             } else
                 LOG_ERROR("Error decoding protobuf for telemetry message!\n");
         };
@@ -435,11 +535,13 @@ std::string MQTT::downstreamPacketToJson(MeshPacket *mp)
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &User_msg, &scratch)) {
                 decoded = &scratch;
-                msgPayload["id"] = new JSONValue(decoded->id);
-                msgPayload["longname"] = new JSONValue(decoded->long_name);
-                msgPayload["shortname"] = new JSONValue(decoded->short_name);
-                msgPayload["hardware"] = new JSONValue(decoded->hw_model);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.key("payload");
+                w.beginObject();
+                w.field("id", (const char *)decoded->id);
+                w.field("longname", (const char *)decoded->long_name);
+                w.field("shortname", (const char *)decoded->short_name);
+                w.field("hardware", (int)decoded->hw_model);
+                w.endObject();
             } else
                 LOG_ERROR("Error decoding protobuf for nodeinfo message!\n");
         };
@@ -453,12 +555,20 @@ std::string MQTT::downstreamPacketToJson(MeshPacket *mp)
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &Position_msg, &scratch)) {
                 decoded = &scratch;
-                if((int)decoded->time){msgPayload["time"] = new JSONValue((int)decoded->time);}
-                if ((int)decoded->timestamp){msgPayload["timestamp"] = new JSONValue((int)decoded->timestamp);}
-                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
-                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
-                if((int)decoded->altitude){msgPayload["altitude"] = new JSONValue((int)decoded->altitude);}
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.key("payload");
+                w.beginObject();
+                if ((int)decoded->time) {
+                    w.field("time", (int)decoded->time);
+                }
+                if ((int)decoded->timestamp) {
+                    w.field("timestamp", (int)decoded->timestamp);
+                }
+                w.field("latitude_i", (int)decoded->latitude_i);
+                w.field("longitude_i", (int)decoded->longitude_i);
+                if ((int)decoded->altitude) {
+                    w.field("altitude", (int)decoded->altitude);
+                }
+                w.endObject();
             } else {
                 LOG_ERROR("Error decoding protobuf for position message!\n");
             }
@@ -474,14 +584,16 @@ std::string MQTT::downstreamPacketToJson(MeshPacket *mp)
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &Waypoint_msg, &scratch)) {
                 decoded = &scratch;
-                msgPayload["id"] = new JSONValue((int)decoded->id);
-                msgPayload["name"] = new JSONValue(decoded->name);
-                msgPayload["description"] = new JSONValue(decoded->description);
-                msgPayload["expire"] = new JSONValue((int)decoded->expire);
-                msgPayload["locked"] = new JSONValue(decoded->locked);
-                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
-                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.key("payload");
+                w.beginObject();
+                w.field("id", (int)decoded->id);
+                w.field("name", (const char *)decoded->name);
+                w.field("description", (const char *)decoded->description);
+                w.field("expire", (int)decoded->expire);
+                w.field("locked", decoded->locked);
+                w.field("latitude_i", (int)decoded->latitude_i);
+                w.field("longitude_i", (int)decoded->longitude_i);
+                w.endObject();
             } else {
                 LOG_ERROR("Error decoding protobuf for position message!\n");
             }
@@ -493,20 +605,18 @@ std::string MQTT::downstreamPacketToJson(MeshPacket *mp)
         break;
     }
 
-    jsonObj["id"] = new JSONValue((int)mp->id);
-    jsonObj["timestamp"] = new JSONValue((int)mp->rx_time);
-    jsonObj["to"] = new JSONValue((int)mp->to);
-    jsonObj["from"] = new JSONValue((int)mp->from);
-    jsonObj["channel"] = new JSONValue((int)mp->channel);
-    jsonObj["type"] = new JSONValue(msgType.c_str());
-    jsonObj["sender"] = new JSONValue(owner.id);
-
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObj);
-    std::string jsonStr = value->Stringify();
-
-    LOG_INFO("serialized json message: %s\n", jsonStr.c_str());
-
-    delete value;
-    return jsonStr;
+    w.field("id", (int)mp->id);
+    w.field("timestamp", (int)mp->rx_time);
+    w.field("to", (int)mp->to);
+    w.field("from", (int)mp->from);
+    w.field("channel", (int)mp->channel);
+    w.field("type", msgType);
+    w.field("sender", (const char *)owner.id);
+    w.endObject();
+
+    if (w.overflowed()) {
+        LOG_ERROR("JSON message for packet 0x%x too large, dropping\n", mp->id);
+        return false;
+    }
+    return true;
 }
@@ -5,6 +5,7 @@
 #include "concurrency/OSThread.h"
 #include "mesh/Channels.h"
 #include "mesh/generated/mqtt.pb.h"
+#include "mesh/mesh-pb-constants.h"
 #include <PubSubClient.h>
 #if HAS_WIFI
 #include <WiFiClient.h>
@@ -13,8 +14,54 @@
 #include <EthernetClient.h>
 #endif
 
+/// Packets we hold for publishing while the broker is unreachable (each entry holds a full MeshPacket copy)
 #define MAX_MQTT_QUEUE 16
 
+/**
+ * Once the heap queue overflows on a board with PSRAM, it moves to a PSRAM one of up to this many entries (enough to ride
+ * out a long Wi-Fi outage), but only ever taking 1/MQTT_QUEUE_PSRAM_SHARE of the PSRAM free at that moment.
+ *
+ * PSRAM is shared between: the S&F history (2/3 of what is free when the server starts), the web server's static file
+ * cache (STATIC_CACHE_PSRAM_SIZE, filled as files are served) and this queue (about 340 bytes an entry).
+ */
+#define MAX_MQTT_QUEUE_PSRAM 512
+#define MQTT_QUEUE_PSRAM_SHARE 8
+
+/// Most bytes we publish from the uplink queue per runOnce pass, so draining a backlog doesn't starve pubSub.loop()
+#define MQTT_UPLINK_BYTES_PER_TICK 4096
+
+/// Longest topic we build (prefix + channel id + "/" + node id)
+#define MQTT_TOPIC_MAX 48
+
+/// How often to log the uplink counters while connected
+#define MQTT_STATS_INTERVAL_MSEC (5 * 60 * 1000)
+
+/// Largest JSON uplink message we will publish
+#define MQTT_JSON_BUF_SIZE 512
+
+/// Most JSON values (including keys) we will accept in a downlink envelope
+#define MQTT_JSON_MAX_TOKENS 32
+
+class JSONWriter;
+
+/// A packet waiting to be published, we keep our own copy because the caller frees theirs as soon as onSend returns
+struct MQTTUplinkEntry {
+    MeshPacket packet;
+    ChannelIndex chIndex;
+    uint32_t queuedAtMsec;
+};
+
+/// Counters for the uplink pipeline, logged every MQTT_STATS_INTERVAL_MSEC
+struct MQTTUplinkStats {
+    uint32_t published;      // packets handed to the broker
+    uint32_t queued;         // packets that had to wait in the uplink queue
+    uint32_t dropped;        // oldest packets discarded because the queue was full
+    uint32_t publishFailed;  // publish() calls the client refused (packet was kept for retry)
+    uint32_t maxQueueDepth;  // high water mark of the uplink queue
+    uint32_t maxLatencyMsec; // worst time a packet spent in the queue
+    uint32_t avgLatencyMsec; // moving average of the time a queued packet waited
+};
+
 /**
  * Our wrapper/singleton for sending/receiving MQTT "udp" packets.  This object isolates the MQTT protocol implementation from
  * the two components that use it: MQTTPlugin and MQTTSimInterface.
@@ -55,7 +102,23 @@ class MQTT : private concurrency::OSThread
     bool connected();
     
   protected:
-    PointerQueue<ServiceEnvelope> mqttQueue;
+    /// Ring buffer of packets waiting for the broker, moved to PSRAM (see MAX_MQTT_QUEUE_PSRAM) the first time it overflows
+    MQTTUplinkEntry *uplinkQueue = NULL;
+    uint16_t uplinkCapacity = 0;
+    uint16_t uplinkHead = 0; // index of the oldest entry
+    uint16_t uplinkCount = 0;
+    bool uplinkGrowTried = false;
+
+    MQTTUplinkStats stats = {};
+    uint32_t lastStatsMsec = 0;
+
+    /// Topics are rebuilt only when a channel's global id changes, not for every publish
+    struct ChannelTopics {
+        char channelId[member_size(ChannelSettings, name)];
+        char crypt[MQTT_TOPIC_MAX];
+        char json[MQTT_TOPIC_MAX];
+    };
+    ChannelTopics topics[MAX_NUM_CHANNELS] = {};
 
     int reconnectCount = 0;
 
@@ -76,8 +139,28 @@ class MQTT : private concurrency::OSThread
     /// Called when a new publish arrives from the MQTT server
     void onPublish(char *topic, byte *payload, unsigned int length);
 
-    /// Called when a new publish arrives from the MQTT server
-    std::string downstreamPacketToJson(MeshPacket *mp);
+    /// Copy a packet into the uplink queue, discarding the oldest entry if it is full
+    void enqueueUplink(const MeshPacket &mp, ChannelIndex chIndex);
+
+    /// Move the uplink queue into a bigger one in PSRAM, returns false if we have none (or already did)
+    bool growUplinkQueue();
+
+    /// Publish queued packets (oldest first) until the queue is empty, the tick's byte budget is used or the client pushes back
+    void drainUplink();
+
+    /**
+     * Publish a packet (and its JSON form if enabled)
+     * @return the number of bytes published, or 0 if the client refused it
+     */
+    size_t publishPacket(const MeshPacket &mp, ChannelIndex chIndex);
+
+    /// Get the (cached) topics for a channel
+    const ChannelTopics &getTopics(ChannelIndex chIndex);
+
+    void logStats();
+
+    /// Serialize a packet as JSON into w, returns false if it didn't fit
+    bool downstreamPacketToJson(MeshPacket *mp, JSONWriter &w);
 
     /// Return 0 if sleep is okay, veto sleep if we are connected to pubsub server
     // int preflightSleepCb(void *unused = NULL) { return pubSub.connected() ? 1 : 0; }    
@@ -22,7 +22,7 @@ class BluetoothPhoneAPI : public PhoneAPI
     {
         PhoneAPI::onNowHasData(fromRadioNum);
 
-        LOG_INFO("BLE notify fromNum\n");
+        LOG_DEBUG("BLE notify fromNum\n");
         
         uint8_t val[4];
         put_le32(val, fromRadioNum);
@@ -53,16 +53,83 @@ class NimbleBluetoothToRadioCallback : public NimBLECharacteristicCallbacks
     }
 };
 
+/**
+ * A FromRadio which didn't fit in the last batch (getFromRadio can't take it back), it is the next thing the connection
+ * which read that batch gets, from either FROMRADIO characteristic
+ */
+static struct {
+    uint16_t connHandle;
+    size_t len;
+    uint8_t bytes[FromRadio_size];
+} fromRadioPending;
+
+static void clearFromRadioPending()
+{
+    fromRadioPending.len = 0;
+}
+
+/// Fetch the next FromRadio for connHandle into buf, leftovers from its last batch first
+static size_t takeFromRadio(uint16_t connHandle, uint8_t *buf)
+{
+    if (fromRadioPending.len) {
+        size_t numBytes = fromRadioPending.len;
+        fromRadioPending.len = 0;
+        if (fromRadioPending.connHandle == connHandle) {
+            memcpy(buf, fromRadioPending.bytes, numBytes);
+            return numBytes;
+        }
+        LOG_WARN("Dropping FromRadio left over for BLE connection %u\n", fromRadioPending.connHandle);
+    }
+    return bluetoothPhoneAPI->getFromRadio(buf);
+}
+
 class NimbleBluetoothFromRadioCallback : public NimBLECharacteristicCallbacks 
 {
-    virtual void onRead(NimBLECharacteristic *pCharacteristic) {
-        LOG_INFO("From Radio onread\n");
+    virtual void onRead(NimBLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc) {
+        LOG_DEBUG("From Radio onread\n");
         uint8_t fromRadioBytes[FromRadio_size];
-        size_t numBytes = bluetoothPhoneAPI->getFromRadio(fromRadioBytes);
+        size_t numBytes = takeFromRadio(desc->conn_handle, fromRadioBytes);
 
-        std::string fromRadioByteString(fromRadioBytes, fromRadioBytes + numBytes);
+        pCharacteristic->setValue(fromRadioBytes, numBytes);
+    }
+};
+
+// The most an attribute value can hold
+#define FROMRADIO_BATCH_MAX_LEN 512
 
-        pCharacteristic->setValue(fromRadioByteString);
+// With room to encode one more FromRadio past the limit, before we find out whether it fits
+static uint8_t fromRadioBatch[FROMRADIO_BATCH_MAX_LEN + 2 + FromRadio_size];
+
+class NimbleBluetoothFromRadioBatchCallback : public NimBLECharacteristicCallbacks 
+{
+    virtual void onRead(NimBLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc) {
+        // A read response carries MTU - 1 bytes, if we stay within that the client never has to do a long read
+        size_t maxLen = bleServer->getPeerMTU(desc->conn_handle) - 1;
+        if (maxLen > FROMRADIO_BATCH_MAX_LEN)
+            maxLen = FROMRADIO_BATCH_MAX_LEN;
+
+        size_t len = 0, count = 0;
+        while (len + 2 < maxLen) {
+            uint8_t *frame = fromRadioBatch + len + 2;
+            size_t numBytes = takeFromRadio(desc->conn_handle, frame);
+            if (!numBytes)
+                break;
+
+            // The first FromRadio always goes out, even if the client will need a long read for it
+            if (count && len + 2 + numBytes > maxLen) {
+                fromRadioPending.connHandle = desc->conn_handle;
+                memcpy(fromRadioPending.bytes, frame, numBytes);
+                fromRadioPending.len = numBytes;
+                break;
+            }
+
+            put_le16(fromRadioBatch + len, numBytes);
+            len += 2 + numBytes;
+            count++;
+        }
+
+        LOG_DEBUG("From Radio batch onread, %u FromRadios in %u bytes\n", count, len);
+        pCharacteristic->setValue(fromRadioBatch, len);
     }
 };
 
@@ -85,6 +152,12 @@ class NimbleBluetoothServerCallback : public NimBLEServerCallbacks
         return passkey;
     }
 
+    virtual void onConnect(NimBLEServer *pServer, ble_gap_conn_desc *desc)
+    {
+        LOG_INFO("BLE connect\n");
+        clearFromRadioPending(); // A new session starts from whatever PhoneAPI sends next
+    }
+
     virtual void onAuthenticationComplete(ble_gap_conn_desc *desc) 
     {
         LOG_INFO("BLE authentication complete\n");
@@ -99,11 +172,13 @@ class NimbleBluetoothServerCallback : public NimBLEServerCallbacks
     virtual void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc *desc)
      {
         LOG_INFO("BLE disconnect\n");
+        clearFromRadioPending(); // Belonged to the old session
     }
 };
 
 static NimbleBluetoothToRadioCallback *toRadioCallbacks;
 static NimbleBluetoothFromRadioCallback *fromRadioCallbacks;
+static NimbleBluetoothFromRadioBatchCallback *fromRadioBatchCallbacks;
 
 void NimbleBluetooth::shutdown()
 {
@@ -148,15 +223,18 @@ void NimbleBluetooth::setupService()
     NimBLEService *bleService = bleServer->createService(MESH_SERVICE_UUID);
     NimBLECharacteristic *ToRadioCharacteristic;
     NimBLECharacteristic *FromRadioCharacteristic;
+    NimBLECharacteristic *FromRadioBatchCharacteristic;
     // Define the characteristics that the app is looking for
     if (config.bluetooth.mode == Config_BluetoothConfig_PairingMode_NO_PIN) {
         ToRadioCharacteristic = bleService->createCharacteristic(TORADIO_UUID, NIMBLE_PROPERTY::WRITE);
         FromRadioCharacteristic = bleService->createCharacteristic(FROMRADIO_UUID, NIMBLE_PROPERTY::READ);
+        FromRadioBatchCharacteristic = bleService->createCharacteristic(FROMRADIO_BATCH_UUID, NIMBLE_PROPERTY::READ);
         fromNumCharacteristic = bleService->createCharacteristic(FROMNUM_UUID, NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::READ);
     }
     else {
         ToRadioCharacteristic = bleService->createCharacteristic(TORADIO_UUID, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_AUTHEN | NIMBLE_PROPERTY::WRITE_ENC);
         FromRadioCharacteristic = bleService->createCharacteristic(FROMRADIO_UUID, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::READ_AUTHEN | NIMBLE_PROPERTY::READ_ENC);
+        FromRadioBatchCharacteristic = bleService->createCharacteristic(FROMRADIO_BATCH_UUID, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::READ_AUTHEN | NIMBLE_PROPERTY::READ_ENC);
         fromNumCharacteristic = bleService->createCharacteristic(FROMNUM_UUID, NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::READ_AUTHEN | NIMBLE_PROPERTY::READ_ENC);
     }
     bluetoothPhoneAPI = new BluetoothPhoneAPI();
@@ -167,6 +245,9 @@ void NimbleBluetooth::setupService()
     fromRadioCallbacks = new NimbleBluetoothFromRadioCallback();
     FromRadioCharacteristic->setCallbacks(fromRadioCallbacks);
 
+    fromRadioBatchCallbacks = new NimbleBluetoothFromRadioBatchCallback();
+    FromRadioBatchCharacteristic->setCallbacks(fromRadioBatchCallbacks);
+
     bleService->start();
 }
 
@@ -194,6 +275,7 @@ void clearNVS()
 {
     NimBLEDevice::deleteAllBonds();
 #ifdef ARCH_ESP32
+    nodeDB.flushSaves();
     ESP.restart();
 #endif
 }
@@ -1,6 +1,7 @@
 #include "CryptoEngine.h"
 #include "PortduinoGPIO.h"
 #include "SPIChip.h"
+#include "mesh/PacketTrace.h"
 #include "mesh/RF95Interface.h"
 #include "sleep.h"
 #include "target_specific.h"
@@ -53,6 +54,9 @@ static GPIOPin *loraIrq;
 
 int TCPPort = 4403; 
 
+/// argp key for --trace, long option only
+#define OPT_PACKET_TRACE 1000
+
 static error_t parse_opt(int key, char *arg, struct argp_state *state) {
   switch (key) {
   case 'p':
@@ -61,6 +65,11 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
     else
         printf("Using TCP port %d\n", TCPPort);
     break;
+  case OPT_PACKET_TRACE:
+    if (!packetTrace.openChromeTrace(arg))
+        return ARGP_ERR_UNKNOWN;
+    printf("Writing packet latency trace to %s\n", arg);
+    break;
   case ARGP_KEY_ARG:
     return 0;
   default:
@@ -70,7 +79,10 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
 }
 
 void portduinoCustomInit() {
-    static struct argp_option options[] = {{"port", 'p', "PORT", 0, "The TCP port to use."}, {0}};
+    static struct argp_option options[] = {
+        {"port", 'p', "PORT", 0, "The TCP port to use."},
+        {"trace", OPT_PACKET_TRACE, "FILE", 0, "Write packet latency traces (Chrome trace-event JSON) to FILE."},
+        {0}};
     static void *childArguments; 
     static char doc[] = "Meshtastic native build.";
     static char args_doc[] = "...";
@@ -1,14 +1,25 @@
+#include "MeshService.h"
 #include "buzz.h"
 #include "configuration.h"
 #include "graphics/Screen.h"
 #include "main.h"
 #include "power.h"
+#ifdef ARCH_ESP32
+#include "modules/esp32/RangeTestModule.h"
+#include "modules/esp32/StoreForwardModule.h"
+#endif
 
 void powerCommandsCheck()
 {
     if (rebootAtMsec && millis() > rebootAtMsec) {
         LOG_INFO("Rebooting\n");
+        nodeDB.flushSaves();
+        service.saveToPhoneQueue();
 #if defined(ARCH_ESP32)
+        if (rangeTestModuleRadio)
+            rangeTestModuleRadio->flushFile();
+        if (storeForwardModule)
+            storeForwardModule->flushHistory();
         ESP.restart();
 #elif defined(ARCH_NRF52)
         NVIC_SystemReset();
@@ -36,6 +47,13 @@ void powerCommandsCheck()
 
     if (shutdownAtMsec && millis() > shutdownAtMsec) {
         LOG_INFO("Shutting down from admin command\n");
+        service.saveToPhoneQueue();
+#ifdef ARCH_ESP32
+        if (rangeTestModuleRadio)
+            rangeTestModuleRadio->flushFile();
+        if (storeForwardModule)
+            storeForwardModule->flushHistory();
+#endif
 #ifdef HAS_PMU
         if (pmu_found == true) {
             playShutdownMelody();
@@ -211,6 +211,7 @@ void doDeepSleep(uint64_t msecToWake)
     screen->doDeepSleep(); // datasheet says this will draw only 10ua
 
     nodeDB.saveToDisk();
+    service.saveToPhoneQueue();
 
     // Kill GPS power completely (even if previously we just had it in sleep mode)
     setGPSPower(false);